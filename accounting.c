@@ -0,0 +1,180 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "accounting.h"
+
+/*
+ * ===========================================================================
+ * CSSE2310 Assignment 3
+ * ACCOUNTING - What each player process costs the machine
+ * ===========================================================================
+ */
+
+/* Function prototypes local to accounting */
+bool write_control(char *dir, char *file, char *text);
+bool read_counter(char *dir, char *file, char *key, long long *value);
+
+/*
+ * Writes to a control file of a cgroup.
+ *
+ * @param dir       the cgroup's directory.
+ * @param file      the control file, e.g. "cpu.max".
+ * @param text      what to write.
+ * @return true if written, false otherwise.
+ */
+bool write_control(char *dir, char *file, char *text) {
+    char path[strlen(dir) + strlen(file) + 2];
+    FILE *control;
+
+    sprintf(path, "%s/%s", dir, file);
+    if ((control = fopen(path, "w")) == NULL) {
+        return false;
+    }
+    // The kernel takes the write when it is flushed
+    fputs(text, control);
+    return fclose(control) == 0;
+}
+
+/*
+ * Reads a counter from a file of a cgroup. Files are either a single
+ * value, or lines of a key and a value.
+ *
+ * @param dir       the cgroup's directory.
+ * @param file      the counter file, e.g. "cpu.stat".
+ * @param key       the counter's key, NULL for single value files.
+ * @param *value    where to store the counter.
+ * @return true if the counter was found, false otherwise.
+ */
+bool read_counter(char *dir, char *file, char *key, long long *value) {
+    char path[strlen(dir) + strlen(file) + 2], line[CGROUP_LINE_LEN];
+    char name[CGROUP_LINE_LEN];
+    bool found = false;
+    FILE *counters;
+
+    sprintf(path, "%s/%s", dir, file);
+    if ((counters = fopen(path, "r")) == NULL) {
+        return false;
+    }
+    while (!found && fgets(line, CGROUP_LINE_LEN, counters) != NULL) {
+        if (key == NULL) {
+            found = sscanf(line, "%lld", value) == 1;
+        } else {
+            found = sscanf(line, "%s %lld", name, value) == 2
+                    && strcmp(name, key) == 0;
+        }
+    }
+    fclose(counters);
+    return found;
+}
+
+/*
+ * Makes a cgroup leaf for a player and sets its limits. Controllers for
+ * any limits must be enabled in the parent's cgroup.subtree_control.
+ *
+ * @param *cost         where to store the leaf's path.
+ * @param parent        cgroup v2 directory the leaf is made in.
+ * @param symbol        the player's symbol.
+ * @param cpuMax        percent of a CPU the player may use, 0 if any.
+ * @param memoryMax     bytes of memory the player may use, 0 if any.
+ * @return true if the leaf was made with its limits, false otherwise.
+ */
+bool make_cgroup(Cost *cost, char *parent, char symbol, int cpuMax,
+        long long memoryMax) {
+    char limit[CGROUP_LINE_LEN];
+
+    if (snprintf(cost->cgroup, PATH_MAX, "%s/%s.%d.%c", parent,
+            CGROUP_PREFIX, (int) getpid(), symbol) >= PATH_MAX
+            || mkdir(cost->cgroup, 0755) == -1) {
+        cost->cgroup[0] = '\0';
+        return false;
+    }
+    if (cpuMax > 0) {
+        sprintf(limit, "%lld %d",
+                (long long) cpuMax * CGROUP_CPU_PERIOD / 100,
+                CGROUP_CPU_PERIOD);
+        if (!write_control(cost->cgroup, "cpu.max", limit)) {
+            remove_cgroup(cost);
+            return false;
+        }
+    }
+    if (memoryMax > 0) {
+        sprintf(limit, "%lld", memoryMax);
+        if (!write_control(cost->cgroup, "memory.max", limit)) {
+            remove_cgroup(cost);
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Moves the calling process into a player's cgroup leaf, so the player
+ * is counted and limited from before it is exec'd.
+ *
+ * @param *cost     the player's cost, with its leaf made.
+ * @return true if moved or there is no leaf, false otherwise.
+ */
+bool join_cgroup(Cost *cost) {
+    char pid[CGROUP_LINE_LEN];
+
+    if (cost->cgroup[0] == '\0') {
+        return true;
+    }
+    sprintf(pid, "%d", (int) getpid());
+    return write_control(cost->cgroup, "cgroup.procs", pid);
+}
+
+/*
+ * Removes a player's cgroup leaf once its process has been reaped.
+ *
+ * @param *cost     the player's cost.
+ */
+void remove_cgroup(Cost *cost) {
+    if (cost->cgroup[0] != '\0') {
+        rmdir(cost->cgroup);
+        cost->cgroup[0] = '\0';
+    }
+}
+
+/*
+ * Prints what a player cost: CPU time, peak memory and context switches
+ * from its rusage, then the counters of its cgroup leaf if it has one.
+ * Counters the kernel doesn't keep are left out.
+ *
+ * @param to        stream to print to.
+ * @param *cost     the player's cost, after it is reaped.
+ * @param symbol    the player's symbol.
+ */
+void report_cost(FILE *to, Cost *cost, char symbol) {
+    struct rusage *usage = &cost->usage;
+    long long value;
+
+    if (cost->reaped) {
+        fprintf(to, "Player %c used %ld.%06lds user %ld.%06lds sys, "
+                "max rss %ldKB, %ld voluntary %ld involuntary switches\n",
+                symbol, (long) usage->ru_utime.tv_sec,
+                (long) usage->ru_utime.tv_usec,
+                (long) usage->ru_stime.tv_sec,
+                (long) usage->ru_stime.tv_usec, usage->ru_maxrss,
+                usage->ru_nvcsw, usage->ru_nivcsw);
+    }
+    if (cost->cgroup[0] == '\0') {
+        return;
+    }
+    fprintf(to, "Player %c cgroup", symbol);
+    if (read_counter(cost->cgroup, "cpu.stat", "usage_usec", &value)) {
+        fprintf(to, " cpu %lldus", value);
+    }
+    if (read_counter(cost->cgroup, "cpu.stat", "nr_throttled", &value)) {
+        fprintf(to, ", throttled %lld times", value);
+    }
+    if (read_counter(cost->cgroup, "memory.peak", NULL, &value)) {
+        fprintf(to, ", memory peak %lld bytes", value);
+    }
+    if (read_counter(cost->cgroup, "memory.events", "oom_kill", &value)) {
+        fprintf(to, ", %lld oom kills", value);
+    }
+    fprintf(to, "\n");
+}
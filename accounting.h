@@ -0,0 +1,82 @@
+#ifndef ACCOUNTING_H
+#define ACCOUNTING_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+
+/*
+ * ===========================================================================
+ * Accounting header file - what each player process costs the machine,
+ * and cgroup v2 leaves that limit it.
+ * ===========================================================================
+ */
+
+/* Leaves are named 2310express.<hub pid>.<player> under the parent */
+#define CGROUP_PREFIX "2310express"
+/* cpu.max is a quota of microseconds in each period */
+#define CGROUP_CPU_PERIOD 100000
+/* Longest line read from a cgroup counter file */
+#define CGROUP_LINE_LEN 128
+
+/* Typedef Structs for readability */
+typedef struct PlayerCost Cost;
+
+/* Resources used by one player process */
+struct PlayerCost {
+    // Filled in when the player is reaped.
+    struct rusage usage;
+    bool reaped;
+    // The player's cgroup leaf, empty if it has none.
+    char cgroup[PATH_MAX];
+};
+
+/*
+ * ===========================================================================
+ * Accounting functions
+ * ===========================================================================
+ */
+/*
+ * Makes a cgroup leaf for a player and sets its limits. Controllers for
+ * any limits must be enabled in the parent's cgroup.subtree_control.
+ *
+ * @param *cost         where to store the leaf's path.
+ * @param parent        cgroup v2 directory the leaf is made in.
+ * @param symbol        the player's symbol.
+ * @param cpuMax        percent of a CPU the player may use, 0 if any.
+ * @param memoryMax     bytes of memory the player may use, 0 if any.
+ * @return true if the leaf was made with its limits, false otherwise.
+ */
+bool make_cgroup(Cost *cost, char *parent, char symbol, int cpuMax,
+        long long memoryMax);
+
+/*
+ * Moves the calling process into a player's cgroup leaf, so the player
+ * is counted and limited from before it is exec'd.
+ *
+ * @param *cost     the player's cost, with its leaf made.
+ * @return true if moved or there is no leaf, false otherwise.
+ */
+bool join_cgroup(Cost *cost);
+
+/*
+ * Removes a player's cgroup leaf once its process has been reaped.
+ *
+ * @param *cost     the player's cost.
+ */
+void remove_cgroup(Cost *cost);
+
+/*
+ * Prints what a player cost: CPU time, peak memory and context switches
+ * from its rusage, then the counters of its cgroup leaf if it has one.
+ * Counters the kernel doesn't keep are left out.
+ *
+ * @param to        stream to print to.
+ * @param *cost     the player's cost, after it is reaped.
+ * @param symbol    the player's symbol.
+ */
+void report_cost(FILE *to, Cost *cost, char symbol);
+
+#endif
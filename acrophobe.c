@@ -55,28 +55,19 @@ void describe_action(Game *game, int id, char message[]) {
 }
 
 /*
- * Player chooses a move based on its strategy.
+ * Player chooses a move based on its strategy. The strategy never changes,
+ * so the hub is left a plan to follow for the rest of the game.
  *
  * @param *game     player's view of the game state.
  * @param id        this player's id
  */
 void choose_move(Game *game, int id) {
-    // String containing reply from player
-    char move[2] = {'\0'};
-
-    // Current position of this player.
-    Position currentPos = game->players[id]->pos;
-    int index = currentPos.y * game->numCarriages + currentPos.x;
-
-    // Loot if loot is available
-    if (game->train[index] > 0) {
-        move[0] = LOOT;
-    } else {
-        // Otherwise, move horizontally.
-        move[0] = MOVE_H;
-    }
+    // Loot if loot is available, otherwise keep moving the same way.
+    char plan[EXT_MSG_MAX_LEN];
+    sprintf(plan, "%d:%c%c%c%c%c%c", game->numRounds, WHEN_LOOT, LOOT,
+            PLAN_NO_POLICY, WHEN_ALWAYS, MOVE_H, KEEP_DIRECTION);
 
-    send_message(stdout, PLAY, move);
+    send_message(stdout, PLAN, plan);
 }
 
 int main(int argc, char **argv) {
@@ -0,0 +1,248 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "banditrules.h"
+#include "comms.h"
+
+/*
+ * ===========================================================================
+ * 2310 Assignment 3
+ * BANDIT RULES - The bandit's strategy, played by the bandit and by the
+ * solver until it starts searching
+ * ===========================================================================
+ */
+
+/*
+ * Finds a short target.
+ *
+ * @param *game     current game state.
+ * @param id        id of player taking shot.
+ * @return player id, in integer form.
+ */
+int select_short(Game *game, int id) {
+    int highestID = -1;
+    Position checkPos, playerPos;
+    playerPos = game->players[id]->pos;
+
+    for (int i = 0; i < game->numPlayers; i++) {
+        checkPos = game->players[i]->pos;
+        // Find highest ID target for short
+        if (checkPos.y == playerPos.y && checkPos.x == playerPos.x
+                && i > highestID && i != id) {
+            highestID = i;
+        }
+    }
+
+    return highestID;
+}
+
+/*
+ * Finds a long target.
+ *
+ * @param *game     current game state.
+ * @param id        id of player takingg shot.
+ * @return player id, in integer form.
+ */
+int select_long(Game *game, int id) {
+    int idLeft = id, idRight = id;
+    Position checkPos, playerPos;
+    playerPos = game->players[id]->pos;
+    // Closest targets so far, from the ends of the train until one is found
+    int closestLeft = 0, closestRight = game->numCarriages - 1;
+    // Roof shots carry the length of the train, inside ones don't
+    bool roof = long_range(game, playerPos.y) > INSIDE_RANGE;
+    for (int i = 0; i < game->numPlayers; i++) {
+        checkPos = game->players[i]->pos;
+        if (i != id && checkPos.y == playerPos.y && checkPos.x < playerPos.x
+                && roof) {
+            // Check roof long, left
+            if (idLeft == id || (i < idLeft && checkPos.x >= closestLeft)) {
+                idLeft = i;
+                closestLeft = checkPos.x;
+            }
+        } else if (i != id && checkPos.y == playerPos.y
+                && checkPos.x > playerPos.x && roof) {
+            // Check roof long, right
+            if (idRight == id || (i < idRight
+                    && checkPos.x <= closestRight)) {
+                idRight = i;
+                closestRight = checkPos.x;
+            }
+        } else if (i != id && checkPos.y == playerPos.y
+                && checkPos.x < playerPos.x
+                && playerPos.x - checkPos.x <= INSIDE_RANGE && !roof) {
+            // Check inside long, left
+            if (idLeft == id || i < idLeft) {
+                idLeft = i;
+            }
+        } else if (i != id && checkPos.y == playerPos.y
+                && checkPos.x > playerPos.x
+                && checkPos.x - playerPos.x <= INSIDE_RANGE && !roof) {
+            // Check inside long, right
+            if (idRight == id || i < idRight) {
+                idRight = i;
+            }
+        }
+    }
+    // A side without a target is left holding our own id
+    if (idRight == id || (idLeft != id && idLeft < idRight)) {
+        return idLeft;
+    } else {
+        return idRight;
+    }
+}
+
+/*
+ * Chooses a direction or target by the bandit rules.
+ *
+ * @param *game     the player's view of the game state.
+ * @param id        this player's id
+ * @param message   the request from the hub
+ */
+void bandit_action(Game *game, int id, char message[]) {
+    // String containing reply from player
+    char action[2] = {'\0'};
+    // Current bandit data
+    Position currentPos = game->players[id]->pos;
+    int nearest, level;
+
+    // Check and reply
+    if (strcmp(message, GET_S_TARGET) == 0) {
+        // Select target if target available.
+        if (!player_here(game, id)) {
+            action[0] = NO_TARGET;
+        } else {
+            int target = select_short(game, id);
+            action[0] = 'A' + target;
+        }
+        send_message(stdout, AIM_SHORT, action);
+    } else if (strcmp(message, GET_DIR) == 0) {
+        // Decide where to move
+        char direction = side_with_most_loot(game, id);
+        if (direction == '?') {
+            // Sides tie, so head for the nearest loot in another carriage
+            nearest = nearest_loot(game, currentPos.x, &level);
+            direction = nearest == -1 || nearest == currentPos.x ? '?'
+                    : nearest < currentPos.x ? DIR_LEFT : DIR_RIGHT;
+        }
+        if (direction == DIR_LEFT) {
+            action[0] = DIR_LEFT;
+        } else if (direction == DIR_RIGHT) {
+            action[0] = DIR_RIGHT;
+        } else if (currentPos.x == 0) {
+            action[0] = DIR_RIGHT;
+        } else {
+            action[0] = DIR_LEFT;
+        }
+        send_message(stdout, GO_DIR, action);
+    } else if (strcmp(message, GET_L_TARGET) == 0) {
+        // Select long target if target available.
+        if (!has_long_target(game, id)) {
+            action[0] = NO_TARGET;
+        } else {
+            int target = select_long(game, id);
+            action[0] = 'A' + target;
+        }
+        send_message(stdout, AIM_LONG, action);
+    }
+}
+
+/*
+ * Checks which level of train has most loot.
+ *
+ * @param *game     current game state.
+ * @return  the level with the most loot, -1 if levels tie for the most.
+ */
+int most_loot_on_level(Game *game) {
+    int most = -1, mostLoot = -1, loot;
+
+    // Gather intel on loot situation
+    for (int y = 0; y < game->numLevels; y++) {
+        loot = 0;
+        for (int i = 0; i < game->numCarriages; i++) {
+            loot += game->train[train_index(game, i, y)];
+        }
+        if (loot > mostLoot) {
+            most = y;
+            mostLoot = loot;
+        } else if (loot == mostLoot) {
+            // loot is even
+            most = -1;
+        }
+    }
+    return most;
+}
+
+/*
+ * Checks which side of train has more loot from bandit's position.
+ *
+ * @param *game     current game state.
+ * @param id        the bandit's id.
+ * @return '-' or '+' depending on which direction has more, else '?'
+ */
+char side_with_most_loot(Game *game, int id) {
+    int left = 0, right = 0;
+    Position currentPos = game->players[id]->pos;
+
+    // Left and right sides, every level
+    for (int y = 0; y < game->numLevels; y++) {
+        for (int i = 0; i < currentPos.x; i++) {
+            left += game->train[train_index(game, i, y)];
+        }
+        for (int i = currentPos.x + 1; i < game->numCarriages; i++) {
+            right += game->train[train_index(game, i, y)];
+        }
+    }
+
+    if (left > right) {
+        return DIR_LEFT;
+    } else if (right > left) {
+        return DIR_RIGHT;
+    } else {
+        return '?';
+    }
+}
+
+/*
+ * Chooses a move by the bandit rules.
+ *
+ * @param *game     player's view of the game state.
+ * @param id        this player's id
+ */
+void bandit_move(Game *game, int id) {
+    // String containing reply from player
+    char move[3] = {'\0'};
+
+    // Current position of this player.
+    Position currentPos = game->players[id]->pos;
+    int index = train_index(game, currentPos.x, currentPos.y);
+    // Last order
+    char order = game->players[id]->orders[0];
+    // Loot distribution
+    int levelLoot, sidewaysLoot;
+
+    // (1) Loot if loot is available
+    if (game->train[index] > 0) {
+        move[0] = LOOT;
+    } else if (player_here(game, id) && order != SHOOT_S &&
+            order != SHOOT_L) {
+        // (2) Short as player is here, and no shot taken previously
+        move[0] = SHOOT_S;
+        move[1] = TARGET_HIGHEST;
+    } else if ((levelLoot = most_loot_on_level(game)) != -1 &&
+            levelLoot != currentPos.y) {
+        // (3) Vertical if another level has more loot
+        move[0] = MOVE_V;
+    } else if ((sidewaysLoot = side_with_most_loot(game, id)) != '?') {
+        // (4) Horizontal movement if either direction has more loot
+        move[0] = MOVE_H;
+    } else if (has_long_target(game, id)) {
+        // (5) Try a long target
+        move[0] = SHOOT_L;
+    } else {
+        // (6) Else, move vertically
+        move[0] = MOVE_V;
+    }
+
+    send_message(stdout, PLAY, move);
+}
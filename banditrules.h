@@ -0,0 +1,47 @@
+#ifndef BANDITRULES_H
+#define BANDITRULES_H
+
+#include "player.h"
+
+/*
+ * ===========================================================================
+ * Bandit rules header file - the bandit's strategy, shared by the bandit
+ * and the solver. select_short and select_long are declared in player.h.
+ * ===========================================================================
+ */
+
+/*
+ * Checks which level of train has most loot.
+ *
+ * @param *game     current game state.
+ * @return  the level with the most loot, -1 if levels tie for the most.
+ */
+int most_loot_on_level(Game *game);
+
+/*
+ * Checks which side of train has more loot from bandit's position.
+ *
+ * @param *game     current game state.
+ * @param id        the bandit's id.
+ * @return '-' or '+' depending on which direction has more, else '?'
+ */
+char side_with_most_loot(Game *game, int id);
+
+/*
+ * Chooses a direction or target by the bandit rules.
+ *
+ * @param *game     the player's view of the game state.
+ * @param id        this player's id
+ * @param message   the request from the hub
+ */
+void bandit_action(Game *game, int id, char message[]);
+
+/*
+ * Chooses a move by the bandit rules.
+ *
+ * @param *game     player's view of the game state.
+ * @param id        this player's id
+ */
+void bandit_move(Game *game, int id);
+
+#endif
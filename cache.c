@@ -0,0 +1,197 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "cache.h"
+#include "output.h"
+
+/*
+ * ===========================================================================
+ * CSSE2310 Assignment 3
+ * CACHE - Storing the output of finished games
+ * ===========================================================================
+ */
+
+/* Function prototypes local to cache */
+FILE *open_program(char *path);
+bool hash_stream(uint64_t hash, FILE *file, uint64_t *result);
+void entry_path(char path[], char *dir, uint64_t key, char *suffix);
+
+/*
+ * Adds bytes to a running hash.
+ *
+ * @param hash      hash so far, CACHE_HASH_START to begin with.
+ * @param *bytes    the bytes to add.
+ * @param length    how many bytes to add.
+ * @return the hash with the bytes added.
+ */
+uint64_t hash_bytes(uint64_t hash, const void *bytes, size_t length) {
+    const unsigned char *next = bytes;
+
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ next[i]) * CACHE_HASH_PRIME;
+    }
+    return hash;
+}
+
+/*
+ * Opens a program for reading, looking for it on the PATH if its name
+ * has no '/' in it, as execlp does.
+ *
+ * @param path      the program.
+ * @return the open program, or NULL if it can't be found.
+ */
+FILE *open_program(char *path) {
+    char *dirs = getenv("PATH"), *dir;
+    FILE *file = NULL;
+
+    if (strchr(path, '/') != NULL || dirs == NULL) {
+        return fopen(path, "rb");
+    }
+    dirs = strdup(dirs);
+    for (dir = strtok(dirs, ":"); dir != NULL && file == NULL;
+            dir = strtok(NULL, ":")) {
+        char fullPath[strlen(dir) + strlen(path) + 2];
+        sprintf(fullPath, "%s/%s", dir, path);
+        if (access(fullPath, X_OK) == 0) {
+            file = fopen(fullPath, "rb");
+        }
+    }
+    free(dirs);
+    return file;
+}
+
+/*
+ * Adds everything left in a stream to a running hash, then closes it.
+ *
+ * @param hash      hash so far.
+ * @param file      the stream, NULL if it couldn't be opened.
+ * @param *result   where to store the hash with the contents added.
+ * @return true if the stream was read, false otherwise.
+ */
+bool hash_stream(uint64_t hash, FILE *file, uint64_t *result) {
+    char buffer[OUTPUT_BUFFER_SIZE];
+    size_t length;
+    bool read;
+
+    if (file == NULL) {
+        return false;
+    }
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        hash = hash_bytes(hash, buffer, length);
+    }
+    read = !ferror(file);
+    fclose(file);
+    *result = hash;
+    return read;
+}
+
+/*
+ * Adds the contents of a file to a running hash. Programs are looked up
+ * the way execlp would, so names without a '/' are found on the PATH.
+ *
+ * @param hash      hash so far.
+ * @param path      the file, usually a player program.
+ * @param *result   where to store the hash with the contents added.
+ * @return true if the file was read, false otherwise.
+ */
+bool hash_program(uint64_t hash, char *path, uint64_t *result) {
+    return hash_stream(hash, open_program(path), result);
+}
+
+/*
+ * Adds the contents of a file that isn't a program to a running hash.
+ *
+ * @param hash      hash so far.
+ * @param path      the file.
+ * @param *result   where to store the hash with the contents added.
+ * @return true if the file was read, false otherwise.
+ */
+bool hash_file(uint64_t hash, char *path, uint64_t *result) {
+    return hash_stream(hash, fopen(path, "rb"), result);
+}
+
+/*
+ * Makes the path of a cache entry.
+ *
+ * @param path      where to store the path, of at least strlen(dir)
+ *                  + strlen(suffix) + CACHE_KEY_LEN + 2.
+ * @param dir       the cache directory.
+ * @param key       the game's key.
+ * @param suffix    added to the end of the name, "" for the entry itself.
+ */
+void entry_path(char path[], char *dir, uint64_t key, char *suffix) {
+    sprintf(path, "%s/%0*llx%s", dir, CACHE_KEY_LEN,
+            (unsigned long long) key, suffix);
+}
+
+/*
+ * Writes the stored output of a game to a stream, if it is in the cache.
+ *
+ * @param dir       the cache directory.
+ * @param key       the game's key.
+ * @param to        stream to write the output to.
+ * @return true if the game was found, false otherwise.
+ */
+bool cache_replay(char *dir, uint64_t key, FILE *to) {
+    char path[strlen(dir) + CACHE_KEY_LEN + 2];
+    char magic[strlen(CACHE_MAGIC)], buffer[OUTPUT_BUFFER_SIZE];
+    uint32_t version;
+    size_t length;
+    FILE *file;
+
+    entry_path(path, dir, key, "");
+    if ((file = fopen(path, "rb")) == NULL) {
+        return false;
+    }
+
+    // Entries of an older layout are played again and replaced
+    if (fread(magic, 1, sizeof(magic), file) != sizeof(magic)
+            || memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0
+            || !get_u32(file, &version) || version != CACHE_VERSION) {
+        fclose(file);
+        return false;
+    }
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        fwrite(buffer, 1, length, to);
+    }
+    fclose(file);
+    return true;
+}
+
+/*
+ * Stores the output of a game in the cache. The entry is written under
+ * another name and renamed into place, so a game being stored is never
+ * seen half written.
+ *
+ * @param dir       the cache directory.
+ * @param key       the game's key.
+ * @param output    everything the game wrote.
+ * @param length    length of the output.
+ * @return true if stored, false otherwise.
+ */
+bool cache_store(char *dir, uint64_t key, char *output, size_t length) {
+    // Names of other hubs' entries in progress differ by pid
+    char suffix[32];
+    sprintf(suffix, ".%d.tmp", (int) getpid());
+    char tempPath[strlen(dir) + strlen(suffix) + CACHE_KEY_LEN + 2];
+    char path[strlen(dir) + CACHE_KEY_LEN + 2];
+    FILE *file;
+
+    entry_path(tempPath, dir, key, suffix);
+    entry_path(path, dir, key, "");
+    if ((file = fopen(tempPath, "wb")) == NULL) {
+        return false;
+    }
+
+    fwrite(CACHE_MAGIC, 1, strlen(CACHE_MAGIC), file);
+    put_u32(file, CACHE_VERSION);
+    fwrite(output, 1, length, file);
+
+    if (fclose(file) == EOF) {
+        remove(tempPath);
+        return false;
+    }
+    return rename(tempPath, path) == 0;
+}
@@ -0,0 +1,87 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * ===========================================================================
+ * Cache header file - storing the output of finished games, so a game
+ * that has been played before isn't played again.
+ * ===========================================================================
+ */
+
+/*
+ * Cache entries are named by their key in hex, and hold the magic "TLCC"
+ * (4 bytes), version (u32, little endian), then the game's output as the
+ * hub wrote it.
+ */
+#define CACHE_MAGIC "TLCC"
+#define CACHE_VERSION 1
+#define CACHE_KEY_LEN 16
+
+/* 64 bit FNV-1a, used for keys and program contents */
+#define CACHE_HASH_START 0xCBF29CE484222325ULL
+#define CACHE_HASH_PRIME 0x100000001B3ULL
+
+/*
+ * ===========================================================================
+ * Cache functions
+ * ===========================================================================
+ */
+/*
+ * Adds bytes to a running hash.
+ *
+ * @param hash      hash so far, CACHE_HASH_START to begin with.
+ * @param *bytes    the bytes to add.
+ * @param length    how many bytes to add.
+ * @return the hash with the bytes added.
+ */
+uint64_t hash_bytes(uint64_t hash, const void *bytes, size_t length);
+
+/*
+ * Adds the contents of a file to a running hash. Programs are looked up
+ * the way execlp would, so names without a '/' are found on the PATH.
+ *
+ * @param hash      hash so far.
+ * @param path      the file, usually a player program.
+ * @param *result   where to store the hash with the contents added.
+ * @return true if the file was read, false otherwise.
+ */
+bool hash_program(uint64_t hash, char *path, uint64_t *result);
+
+/*
+ * Adds the contents of a file that isn't a program to a running hash.
+ *
+ * @param hash      hash so far.
+ * @param path      the file.
+ * @param *result   where to store the hash with the contents added.
+ * @return true if the file was read, false otherwise.
+ */
+bool hash_file(uint64_t hash, char *path, uint64_t *result);
+
+/*
+ * Writes the stored output of a game to a stream, if it is in the cache.
+ *
+ * @param dir       the cache directory.
+ * @param key       the game's key.
+ * @param to        stream to write the output to.
+ * @return true if the game was found, false otherwise.
+ */
+bool cache_replay(char *dir, uint64_t key, FILE *to);
+
+/*
+ * Stores the output of a game in the cache. The entry is written under
+ * another name and renamed into place, so a game being stored is never
+ * seen half written.
+ *
+ * @param dir       the cache directory.
+ * @param key       the game's key.
+ * @param output    everything the game wrote.
+ * @param length    length of the output.
+ * @return true if stored, false otherwise.
+ */
+bool cache_store(char *dir, uint64_t key, char *output, size_t length);
+
+#endif
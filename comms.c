@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
+#include <ctype.h>
 #include "comms.h"
 
 /*
@@ -20,12 +21,23 @@
  * @param params    information accompanying message, if any
  */
 void send_message(FILE *to, char *body, char *params) {
+    buffer_message(to, body, params);
+    fflush(to);
+}
+
+/*
+ * Writes a message to a destination without flushing, so that several
+ * messages can leave in a single write.
+ *
+ * @param *to       destination of this message
+ * @param body      message body defined in comms protocol
+ * @param params    information accompanying message, if any
+ */
+void buffer_message(FILE *to, char *body, char *params) {
     if (params == NULL) {
         fprintf(to, "%s\n", body);
-        fflush(to);
     } else {
         fprintf(to, "%s%s\n", body, params);
-        fflush(to);
     }
 }
 
@@ -40,6 +52,30 @@ void message_all(Game *game, char *message, char *params) {
     }
 }
 
+/*
+ * Bulk writes a message to all players without flushing.
+ *
+ * @param *game     the state of the game according to the hub.
+ * @param message   message body defined in comms protocol
+ * @param params    information accompanying message, if any
+ */
+void buffer_all(Game *game, char *message, char *params) {
+    for (int i = 0; i < game->numPlayers; i++) {
+        buffer_message(game->players[i]->input, message, params);
+    }
+}
+
+/*
+ * Flushes any buffered messages to all players.
+ *
+ * @param *game     the state of the game according to the hub.
+ */
+void flush_all(Game *game) {
+    for (int i = 0; i < game->numPlayers; i++) {
+        fflush(game->players[i]->input);
+    }
+}
+
 /*
  * Checks if message is valid message and has correct number of params.
  * Note - only checks FORMAT of message, not whether the provided params
@@ -55,12 +91,21 @@ bool hub_message_valid(char message[]) {
             || strcmp(message, EXECUTE) == 0
             || strcmp(message, GET_DIR) == 0
             || strcmp(message, GET_S_TARGET) == 0
-            || strcmp(message, GET_L_TARGET) == 0) {
+            || strcmp(message, GET_L_TARGET) == 0
+            || strcmp(message, SYNC) == 0) {
         return true;
     }
 
     // Check message format for messages with extra parameters
-    if (strstr(message, ORDERED) != NULL &&
+    if (strncmp(message, STATE, strlen(STATE)) == 0) {
+        // Entries are checked as they are applied
+        return isdigit(message[strlen(STATE)]);
+    } else if (strncmp(message, NEW_GAME, strlen(NEW_GAME)) == 0) {
+        return isdigit(message[strlen(NEW_GAME)]);
+    } else if (strncmp(message, GET_ACTION, strlen(GET_ACTION)) == 0) {
+        // Legal actions are checked as they are read
+        return isxdigit(message[strlen(GET_ACTION)]);
+    } else if (strstr(message, ORDERED) != NULL &&
             strlen(message) == strlen(ORDERED) + 2) {
         return true;
     } else if (strstr(message, TELL_HMOVE) != NULL &&
@@ -87,6 +132,32 @@ bool hub_message_valid(char message[]) {
     return false;
 }
 
+/*
+ * Checks if a plan message has a round count and whole rules.
+ * Note - checks for FORMAT only, does not check rule contents.
+ *
+ * @param message       the message sent by the player.
+ */
+bool plan_message_valid(char message[]) {
+    char *rules = message + strlen(PLAN);
+    int digits = 0, numRules;
+
+    if (strncmp(message, PLAN, strlen(PLAN)) != 0) {
+        return false;
+    }
+    // Round count, then rules of three characters each.
+    while (isdigit(rules[digits])) {
+        digits++;
+    }
+    if (digits == 0 || rules[digits] != ':') {
+        return false;
+    }
+    rules += digits + 1;
+    numRules = strlen(rules) / 3;
+    return strlen(rules) % 3 == 0 && numRules > 0
+            && numRules <= PLAN_MAX_RULES;
+}
+
 /*
  * Checks if the player sent a valid message.
  * Note - checks for FORMAT only, does not check parameter legality.
@@ -95,10 +166,14 @@ bool hub_message_valid(char message[]) {
  */
 bool player_message_valid(char message[]) {
     /* Check message format and extra parameters exists.
-     * All messages have one param. E.g., PlayX.
+     * All messages have one param. E.g., PlayX. Play may also carry a
+     * policy for the order, e.g. Playhc. Plans have their own format.
      */
-    if (strstr(message, PLAY) != NULL &&
-            strlen(message) == strlen(PLAY) + 1) {
+    if (strncmp(message, PLAN, strlen(PLAN)) == 0) {
+        return plan_message_valid(message);
+    } else if (strstr(message, PLAY) != NULL &&
+            (strlen(message) == strlen(PLAY) + 1
+            || strlen(message) == strlen(PLAY) + 2)) {
         return true;
     } else if (strstr(message, GO_DIR) != NULL &&
             strlen(message) == strlen(GO_DIR) + 1) {
@@ -109,6 +184,9 @@ bool player_message_valid(char message[]) {
     } else if (strstr(message, AIM_LONG) != NULL &&
             strlen(message) == strlen(AIM_LONG) + 1) {
         return true;
+    } else if (strstr(message, HASH) != NULL &&
+            strlen(message) == strlen(HASH) + HASH_DIGITS) {
+        return true;
     }
 
     // Message not valid for protocols
@@ -116,60 +194,168 @@ bool player_message_valid(char message[]) {
 }
 
 /*
- * Checks if an action is legal.
+ * Writes the state message entry for a player, e.g. "A=2,1,3,0,h+"
+ * for position, loot, hits and last orders.
+ *
+ * @param *game     game state the player is in.
+ * @param id        the player.
+ * @param entry     buffer of STATE_ENTRY_LEN for the entry.
+ */
+void player_state_entry(Game *game, int id, char entry[]) {
+    Player *player = game->players[id];
+    char orders[2];
+
+    // Orders not yet given are sent as placeholders
+    for (int i = 0; i < 2; i++) {
+        orders[i] = player->orders[i] == '\0' ? STATE_NO_ORDER
+                : player->orders[i];
+    }
+    snprintf(entry, STATE_ENTRY_LEN, "%c=%d,%d,%d,%d,%c%c", player->symbol,
+            player->pos.x, player->pos.y, player->loot, player->hits,
+            orders[0], orders[1]);
+}
+
+/*
+ * Writes the state message entry for a spot on the train, e.g. "#7=0".
+ *
+ * @param *game     game state the train belongs to.
+ * @param index     spot on the train, level * carriages + carriage.
+ * @param entry     buffer of STATE_ENTRY_LEN for the entry.
+ */
+void cell_state_entry(Game *game, int index, char entry[]) {
+    snprintf(entry, STATE_ENTRY_LEN, "%c%d=%d", STATE_CELL, index,
+            game->train[index]);
+}
+
+/*
+ * Checks if a policy may be committed with an order.
+ *
+ * @param order     the order type.
+ * @param policy    the direction/target policy sent with it.
+ * @return true if the policy suits the order, else false.
+ */
+bool policy_valid(char order, char policy) {
+    if (policy == NO_POLICY) {
+        return false;
+    } else if (order == MOVE_H) {
+        return strchr(VALID_DIR_POLICIES, policy) != NULL;
+    } else if (order == SHOOT_S || order == SHOOT_L) {
+        return strchr(VALID_TARGET_POLICIES, policy) != NULL;
+    }
+    // Other orders have nothing to complete
+    return false;
+}
+
+/*
+ * Finds the legal actions of a player in one pass over the players.
+ * Short shots need a player in the same carriage, on either level. Long
+ * shots need a player on the same level, within the level's long_range.
+ *
+ * @param *game     current game state.
+ * @param id        the player acting.
+ * @param *legal    where to store the legal actions.
+ */
+void find_legal(Game *game, int id, Legal *legal) {
+    Position pos = game->players[id]->pos, other;
+    int range = long_range(game, pos.y);
+
+    legal->moves = 0;
+    legal->shortTargets = 0;
+    legal->longTargets = 0;
+    if (pos.x > 0) {
+        legal->moves |= LEGAL_LEFT;
+    }
+    if (pos.x < game->numCarriages - 1) {
+        legal->moves |= LEGAL_RIGHT;
+    }
+    for (int i = 0; i < game->numPlayers; i++) {
+        other = game->players[i]->pos;
+        if (i == id) {
+            continue;
+        }
+        if (other.x == pos.x) {
+            legal->shortTargets |= 1u << i;
+        } else if (other.y == pos.y && abs(other.x - pos.x) <= range) {
+            legal->longTargets |= 1u << i;
+        }
+    }
+}
+
+/*
+ * Narrows short targets to the players in the same spot as the shooter.
+ * Any level of the carriage may be shot, but strategies and policies
+ * only aim at their own level.
  *
  * @param *game     current game state.
- * @param id        id of this player's action
+ * @param id        the player shooting.
+ * @param targets   short targets, bit i set if player i may be shot.
+ * @return the targets on the shooter's level.
+ */
+unsigned int targets_here(Game *game, int id, unsigned int targets) {
+    for (int i = 0; i < game->numPlayers; i++) {
+        if (game->players[i]->pos.y != game->players[id]->pos.y) {
+            targets &= ~(1u << i);
+        }
+    }
+    return targets;
+}
+
+/*
+ * Checks if an order is legal, by bit test against legal actions.
+ *
+ * @param *legal    legal actions of the player ordering.
+ * @param order     the order type.
+ * @param param     direction or target of the order, if it has one.
  * @return true if legal action, else false.
  */
-bool move_is_legal(Game *game, int id) {
-    // Order for checking
-    char order = game->players[id]->newOrders[0];
-    char param = game->players[id]->newOrders[1];
-    // Players current position
-    Position pos = game->players[id]->pos;
+bool order_is_legal(Legal *legal, char order, char param) {
+    unsigned int targets;
 
-    if (order == MOVE_H && param == DIR_LEFT && pos.x != 0) {
-        // Player is not moving off leftmost carriage
-        return true;
-    } else if (order == MOVE_H && param == DIR_RIGHT &&
-            pos.x != game->numCarriages - 1) {
-        // Player not moving off rightmost carriage
-        return true;
-    } else if ((order == SHOOT_S || order == SHOOT_L) && param == NO_TARGET) {
-        return true;
-    } else if (order == SHOOT_S &&
-            game->players[param - 'A']->pos.x == pos.x &&
-            param != game->players[id]->symbol) {
-        // Short target is in same carriage, and not itself.
-        return true;
-    } else if (order == SHOOT_L && pos.y == 0
-            && game->players[param - 'A']->pos.y == 0
-            && param != game->players[id]->symbol
-            && (game->players[param - 'A']->pos.x == pos.x - 1
-            || game->players[param - 'A']->pos.x == pos.x + 1)) {
-        // Long target, on lower level is one carriage away
-        return true;
-    } else if (order == SHOOT_L && pos.y == 1
-            && game->players[param - 'A']->pos.y == 1
-            && param != game->players[id]->symbol
-            && game->players[param - 'A']->pos.x != pos.x) {
-        // Long target upper level, not in same carriage, any distance fine.
-        Position tempPos, targetPos;
-        for (int i = 0; i < game->numPlayers; i++) {
-            tempPos = game->players[i]->pos;
-            targetPos = game->players[param - 'A']->pos;
-            if (i != id && i != (param - 'A') && tempPos.y == 1) {
-                if ((targetPos.x > pos.x && targetPos.x <= tempPos.x)
-                        || (targetPos.x < pos.x && targetPos.x >= tempPos.x)) {
-                    return true;
-                }
+    switch (order) {
+        case MOVE_H:
+            return (param == DIR_LEFT && (legal->moves & LEGAL_LEFT))
+                    || (param == DIR_RIGHT && (legal->moves & LEGAL_RIGHT));
+        case SHOOT_S:
+        case SHOOT_L:
+            if (param == NO_TARGET) {
+                return true;
             }
-        }
-    } else if (order == MOVE_V || order == LOOT || order == DRY) {
-        // These orders have no params, thus should be legal
-        return true;
+            targets = order == SHOOT_S ? legal->shortTargets
+                    : legal->longTargets;
+            return param >= 'A' && param < 'A' + MAX_PLAYERS
+                    && (targets >> (param - 'A') & 1);
+        case MOVE_V:
+        case LOOT:
+        case DRY:
+            // These orders have no params, thus should be legal
+            return true;
     }
     // Move illegal if here
     return false;
 }
+
+/*
+ * Writes legal actions as message params, e.g. "3,0,4" for the moves,
+ * short targets and long targets in hex.
+ *
+ * @param *legal    the legal actions.
+ * @param params    buffer of LEGAL_PARAMS_LEN for the params.
+ */
+void legal_params(Legal *legal, char params[]) {
+    sprintf(params, "%x,%x,%x", legal->moves, legal->shortTargets,
+            legal->longTargets);
+}
+
+/*
+ * Reads legal actions sent as message params.
+ *
+ * @param params    the params, as written by legal_params.
+ * @param *legal    where to store the legal actions.
+ * @return true if the params were whole, else false.
+ */
+bool read_legal(char params[], Legal *legal) {
+    int length = 0;
+
+    return sscanf(params, "%x,%x,%x%n", &legal->moves, &legal->shortTargets,
+            &legal->longTargets, &length) == 3 && params[length] == '\0';
+}
@@ -17,6 +17,8 @@
 #define MAX_PARAMS 3
 // Message max including \n and \0
 #define MSG_MAX_LEN 15
+// Message max for protocol extensions, including \n and \0
+#define EXT_MSG_MAX_LEN 1024
 
 /* Valid moves */
 #define VALID_MOVES "vlhs$d"
@@ -30,6 +32,26 @@
 #define DIR_RIGHT '+'
 #define NO_TARGET '-'
 
+/* Policies a player may commit with its order, resolved by the hub */
+#define VALID_DIR_POLICIES "+-c"
+#define VALID_TARGET_POLICIES "n<>-"
+#define NO_POLICY '\0'
+#define KEEP_DIRECTION 'c'
+#define TARGET_NEAREST 'n'
+#define TARGET_LOWEST '<'
+#define TARGET_HIGHEST '>'
+
+/* Plan rule predicates, checked by the hub against its own state */
+#define VALID_PREDICATES "*$p<>^_"
+#define WHEN_ALWAYS '*'
+#define WHEN_LOOT '$'
+#define WHEN_PLAYER 'p'
+#define WHEN_LEFT_END '<'
+#define WHEN_RIGHT_END '>'
+#define WHEN_UPPER '^'
+#define WHEN_LOWER '_'
+#define PLAN_NO_POLICY '.'
+
 /* Messages from Hub */
 #define GAME_OVER "game_over"
 #define NEW_ROUND "round"
@@ -45,9 +67,27 @@
 #define TELL_SHORT "short"
 #define TELL_LOOT "looted"
 #define TELL_DRY "driedout"
+#define SYNC "sync"
+#define STATE "state"
+// Legal actions may follow yourturn, e.g. yourturn3,0,4, see legal_params
+#define LEGAL_PARAMS_LEN 32
+// Sent to connected players, e.g. new_game3,0,5,283 for pcount,id,width,seed
+#define NEW_GAME "new_game"
 
 /* Messages from player */
 #define PLAY "play"
+#define PLAN "plan"
+#define HASH "hash"
+
+/* Hex digits of a game hash sent in reply to sync */
+#define HASH_DIGITS 16
+
+/* State messages, e.g. state6;A=2,1,3,0,h+;#7=0 */
+#define STATE_SEPARATOR ';'
+#define STATE_CELL '#'
+#define STATE_NO_ORDER '.'
+// Longest entry in a state message, without separator
+#define STATE_ENTRY_LEN 64
 #define GO_DIR "sideways"
 #define AIM_SHORT "target_short"
 #define AIM_LONG "target_long"
@@ -68,6 +108,16 @@
  */
 void send_message(FILE *to, char *body, char *params);
 
+/*
+ * Writes a message to a destination without flushing, so that several
+ * messages can leave in a single write.
+ *
+ * @param *to       destination of this message
+ * @param body      message body defined in comms protocol
+ * @param params    information accompanying message, if any
+ */
+void buffer_message(FILE *to, char *body, char *params);
+
 /*
  * Bulk sends a message to all players.
  *
@@ -75,6 +125,22 @@ void send_message(FILE *to, char *body, char *params);
  */
 void message_all(Game *game, char *message, char *params);
 
+/*
+ * Bulk writes a message to all players without flushing.
+ *
+ * @param *game     the state of the game according to the hub.
+ * @param message   message body defined in comms protocol
+ * @param params    information accompanying message, if any
+ */
+void buffer_all(Game *game, char *message, char *params);
+
+/*
+ * Flushes any buffered messages to all players.
+ *
+ * @param *game     the state of the game according to the hub.
+ */
+void flush_all(Game *game);
+
 /*
  * Checks if message is valid message and has correct number of params.
  * Note - only checks FORMAT of message, not whether the provided params
@@ -84,6 +150,14 @@ void message_all(Game *game, char *message, char *params);
  */
 bool hub_message_valid(char message[]);
 
+/*
+ * Checks if a plan message has a round count and whole rules.
+ * Note - checks for FORMAT only, does not check rule contents.
+ *
+ * @param message       the message sent by the player.
+ */
+bool plan_message_valid(char message[]);
+
 /*
  * Checks if the player sent a valid message.
  * Note - checks for FORMAT only, does not check parameters.
@@ -93,12 +167,82 @@ bool hub_message_valid(char message[]);
 bool player_message_valid(char message[]);
 
 /*
- * Checks if an action is legal.
+ * Writes the state message entry for a player, e.g. "A=2,1,3,0,h+"
+ * for position, loot, hits and last orders.
+ *
+ * @param *game     game state the player is in.
+ * @param id        the player.
+ * @param entry     buffer of STATE_ENTRY_LEN for the entry.
+ */
+void player_state_entry(Game *game, int id, char entry[]);
+
+/*
+ * Writes the state message entry for a spot on the train, e.g. "#7=0".
+ *
+ * @param *game     game state the train belongs to.
+ * @param index     spot on the train, level * carriages + carriage.
+ * @param entry     buffer of STATE_ENTRY_LEN for the entry.
+ */
+void cell_state_entry(Game *game, int index, char entry[]);
+
+/*
+ * Checks if a policy may be committed with an order.
+ *
+ * @param order     the order type.
+ * @param policy    the direction/target policy sent with it.
+ * @return true if the policy suits the order, else false.
+ */
+bool policy_valid(char order, char policy);
+
+/*
+ * Finds the legal actions of a player in one pass over the players.
+ * Short shots need a player in the same carriage, on either level. Long
+ * shots need a player on the same level, within the level's long_range.
+ *
+ * @param *game     current game state.
+ * @param id        the player acting.
+ * @param *legal    where to store the legal actions.
+ */
+void find_legal(Game *game, int id, Legal *legal);
+
+/*
+ * Narrows short targets to the players in the same spot as the shooter.
+ * Any level of the carriage may be shot, but strategies and policies
+ * only aim at their own level.
  *
  * @param *game     current game state.
- * @param id        id of this player's action
+ * @param id        the player shooting.
+ * @param targets   short targets, bit i set if player i may be shot.
+ * @return the targets on the shooter's level.
+ */
+unsigned int targets_here(Game *game, int id, unsigned int targets);
+
+/*
+ * Checks if an order is legal, by bit test against legal actions.
+ *
+ * @param *legal    legal actions of the player ordering.
+ * @param order     the order type.
+ * @param param     direction or target of the order, if it has one.
  * @return true if legal action, else false.
  */
-bool move_is_legal(Game *game, int id);
+bool order_is_legal(Legal *legal, char order, char param);
+
+/*
+ * Writes legal actions as message params, e.g. "3,0,4" for the moves,
+ * short targets and long targets in hex.
+ *
+ * @param *legal    the legal actions.
+ * @param params    buffer of LEGAL_PARAMS_LEN for the params.
+ */
+void legal_params(Legal *legal, char params[]);
+
+/*
+ * Reads legal actions sent as message params.
+ *
+ * @param params    the params, as written by legal_params.
+ * @param *legal    where to store the legal actions.
+ * @return true if the params were whole, else false.
+ */
+bool read_legal(char params[], Legal *legal);
 
 #endif
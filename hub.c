@@ -1,15 +1,32 @@
+// fopencookie, for player streams that queue instead of waiting
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <errno.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <string.h>
+#include <getopt.h>
+#include <poll.h>
 #include "hub.h"
 #include "comms.h"
+#include "output.h"
+#include "logging.h"
+#include "trace.h"
+#include "snapshot.h"
+#include "sockets.h"
+#include "cache.h"
+#include "scenario.h"
+#include "accounting.h"
+#include "perf.h"
+#include "stats.h"
 
 /*
  * ===========================================================================
@@ -18,10 +35,18 @@
  * ===========================================================================
  */
 
-// Global store of players associated with hub for exit handling
-Player **globalPlayers;
-// Count of players for use in globalPlayers iteration
-int playerCount;
+// Every task made, so their players can be shut down at exit
+Task **playing;
+int numPlaying;
+// Optional hub modes
+Options options = DEFAULT_OPTIONS;
+// Copy of the game's output kept for the cache, NULL if not caching
+FILE *record;
+char *recorded;
+size_t recordedLength;
+// What players did in every game so far, and where counts go
+Stats totalStats;
+FILE *statsFile;
 
 /* ===========================================================================
  * Hub handler functions
@@ -41,18 +66,26 @@ void handle_sig(int sig) {
 /*
  * Checks if player exited cleanly.
  *
+ * @param *task     the task the player belongs to.
  * @param player    the id of the player.
  * @return true if player exited, false otherwise.
  */
-bool player_exit(int player) {
+bool player_exit(Task *task, int player) {
+    Cost *cost = &task->costs[player];
     int status;
-    waitpid(globalPlayers[player]->pid, &status, WNOHANG);
+    if (wait4(task->game->players[player]->pid, &status, WNOHANG,
+            &cost->usage) <= 0) {
+        // Player still running
+        return false;
+    }
+    cost->reaped = true;
 
     if (WIFEXITED(status)) {
         // Print exit status
         if (WEXITSTATUS(status) > 0) {
             fprintf(stderr, "Player %c ended with status %d\n",
-                    globalPlayers[player]->symbol, WEXITSTATUS(status));
+                    task->game->players[player]->symbol,
+                    WEXITSTATUS(status));
             return true;
         } else if (WEXITSTATUS(status) == 0) {
             return true;
@@ -67,18 +100,56 @@ bool player_exit(int player) {
  * @param exitStatus    the exit status being handled.
  */
 void exit_clean_up(int exitStatus) {
-    for (int i = 0; i < playerCount; i++) {
-        if (globalPlayers[i]->input != NULL) {
-            fprintf(globalPlayers[i]->input, "%s\n", GAME_OVER);
+    int span = trace_begin(TRACE_HUB, "exit_clean_up", "%d", exitStatus);
+    bool started = false;
+    Player *player;
+    Cost *cost;
+
+    // Messages already sent are let out, as they were when writes waited
+    for (int i = 0; i < numPlaying; i++) {
+        drain_queues(playing[i], QUEUE_DRAIN_MS);
+    }
+    // Every player is told first, so they all share the wait to exit.
+    // Connected players stay up, but hear of games cut short.
+    for (int i = 0; i < numPlaying; i++) {
+        for (int j = 0; j < playing[i]->game->numPlayers; j++) {
+            player = playing[i]->game->players[j];
+            if (player->input != NULL && (player->pid != 0
+                    || exitStatus != EXIT_SUCCESS)) {
+                fprintf(player->input, "%s\n", GAME_OVER);
+                fflush(player->input);
+            }
+            started = started || player->pid != 0;
         }
-        // did player exit?
+    }
+    // did players exit?
+    if (started) {
         sleep(2);
-        if (!player_exit(i)) {
-            kill(globalPlayers[i]->pid, SIGKILL);
-            fprintf(stderr, "Player %c shutdown after receiving signal %d\n",
-                    globalPlayers[i]->symbol, SIGKILL);
+    }
+    for (int i = 0; i < numPlaying; i++) {
+        for (int j = 0; j < playing[i]->game->numPlayers; j++) {
+            player = playing[i]->game->players[j];
+            cost = &playing[i]->costs[j];
+            if (player->pid == 0) {
+                continue;
+            }
+            if (!player_exit(playing[i], j)) {
+                kill(player->pid, SIGKILL);
+                fprintf(stderr,
+                        "Player %c shutdown after receiving signal %d\n",
+                        player->symbol, SIGKILL);
+                // Reaped so its usage is counted and its cgroup can go
+                if (wait4(player->pid, NULL, 0, &cost->usage) > 0) {
+                    cost->reaped = true;
+                }
+            }
+            if (options.accounting) {
+                report_cost(stderr, cost, player->symbol);
+            }
+            remove_cgroup(cost);
         }
     }
+    trace_end(span);
 }
 
 /*
@@ -87,7 +158,16 @@ void exit_clean_up(int exitStatus) {
  * @params exitStatus   the exit code associated with exit handler call.
  */
 void handle_exit(int exitStatus) {
+    exit_message(exitStatus);
+    exit_hub(exitStatus);
+}
 
+/*
+ * Prints why the hub or a game is ending.
+ *
+ * @param exitStatus    the exit code.
+ */
+void exit_message(int exitStatus) {
     switch(exitStatus) {
         case WRONG_ARGS:
             // Wrong number of arguments
@@ -120,16 +200,30 @@ void handle_exit(int exitStatus) {
             fprintf(stderr, "Illegal move by client\n");
             break;
 
+        case DESYNC:
+            // Player sees a different game to the hub
+            fprintf(stderr, "Client out of sync\n");
+            break;
+
         case GOT_SIGINT:
             // Caught and handled sigint
             fprintf(stderr, "SIGINT caught\n");
             break;
     }
+}
 
+/*
+ * Shuts players down if the exit status calls for it, then exits.
+ *
+ * @param exitStatus    the exit code.
+ */
+void exit_hub(int exitStatus) {
     // Clean up players
     if (exitStatus >= PROCESS_FAIL || exitStatus == EXIT_SUCCESS) {
         exit_clean_up(exitStatus);
     }
+    trace_write();
+    perf_close();
     exit(exitStatus);
 }
 
@@ -145,11 +239,13 @@ void handle_exit(int exitStatus) {
  * @param input         input to player pipe
  * @param output        output from player pipe
  * @param *playerPath   path for player file.
- * @param *game         game struct with game data
+ * @param *task         task whose game the player is in
  * @param id            the id of this player
  */
-void setup_child_fork(int input[], int output[], char *playerPath, Game *game,
+void setup_child_fork(int input[], int output[], char *playerPath, Task *task,
         int id) {
+    Game *game = task->game;
+
     // Setup input to player pipe.
     if (close(input[WRITE]) == -1 || dup2(input[READ], READ) == -1 ||
             close(input[READ]) == -1) {
@@ -162,11 +258,21 @@ void setup_child_fork(int input[], int output[], char *playerPath, Game *game,
         handle_exit(PROCESS_FAIL);
     }
 
-    // Close stderr, lowest fd will be stderr as stdin and stdout used
-    if (fclose(stderr) == EOF || open("/dev/null", O_RDWR) == -1) {
+    // Counted and limited from before the player starts
+    if (!join_cgroup(&task->costs[id])) {
         handle_exit(PROCESS_FAIL);
     }
 
+    // Players log to our stderr only when PLAYER_LOG asks them to.
+    // Otherwise close stderr, lowest fd will be stderr as stdin and
+    // stdout used, and nothing is logged since nobody would read it.
+    if (getenv(LOG_ENV) == NULL) {
+        if (fclose(stderr) == EOF || open("/dev/null", O_RDWR) == -1) {
+            handle_exit(PROCESS_FAIL);
+        }
+        setenv(LOG_ENV, "off", 1);
+    }
+
     // Store parameters as strings for exec args, buffer +1 for terminator.
     char numPlayers[num_digits(game->numPlayers) + 1];
     sprintf(numPlayers, "%d", game->numPlayers);
@@ -180,9 +286,22 @@ void setup_child_fork(int input[], int output[], char *playerPath, Game *game,
     char seed[num_digits((int) game->seed) + 1];
     sprintf(seed, "%d", game->seed);
 
-    // Exec player if pipe setup complete
-    execlp(playerPath, playerPath, numPlayers, thisID, numCarriages,
-            seed, NULL);
+    char numLevels[num_digits(game->numLevels) + 1];
+    sprintf(numLevels, "%d", game->numLevels);
+
+    char numRounds[num_digits(game->numRounds) + 1];
+    sprintf(numRounds, "%d", game->numRounds);
+
+    // Exec player if pipe setup complete, levels and rounds are only
+    // given if they aren't the usual.
+    if (game->numLevels == DEFAULT_LEVELS
+            && game->numRounds == DEFAULT_ROUNDS) {
+        execlp(playerPath, playerPath, numPlayers, thisID, numCarriages,
+                seed, NULL);
+    } else {
+        execlp(playerPath, playerPath, numPlayers, thisID, numCarriages,
+                seed, numLevels, numRounds, NULL);
+    }
 
     // Exec failed if we got here
     handle_exit(PROCESS_FAIL);
@@ -193,44 +312,47 @@ void setup_child_fork(int input[], int output[], char *playerPath, Game *game,
  *
  * @param input    input to player pipe
  * @param output   output from player pipe
- * @param *game    game structure and data
+ * @param *task    task whose game the player is in
  * @param id       player ID per position in player array
  * @param pid      player process PID
  */
-void setup_parent_fork(int input[], int output[], Game *game, int id,
+void setup_parent_fork(int input[], int output[], Task *task, int id,
         pid_t pid) {
+    Player *player = task->game->players[id];
+
     // Close pipe ends for parent side.
     if (close(input[READ]) == -1 || close(output[WRITE]) == -1) {
         handle_exit(PROCESS_FAIL);
     }
 
     // Store player information
-    if ((game->players[id]->input = fdopen(input[WRITE], "w")) == NULL ||
-            (game->players[id]->output = fdopen(output[READ], "r")) == NULL) {
+    if ((player->input = open_queue(input[WRITE], &task->outbound[id]))
+            == NULL || (player->output = fdopen(output[READ], "r")) == NULL) {
         handle_exit(PROCESS_FAIL);
     }
-    game->players[id]->pid = pid;
-
-    // Associate player in global player holder
-    globalPlayers[id] = game->players[id];
-    playerCount++;
+    player->pid = pid;
 }
 
 /*
  * Setup pipes for players and execs player process.
  *
- * @param *game         struct representing the Game.
+ * @param *task         task whose game the player is in.
  * @param id            id of player in array of players.
  * @param *playerPaths  array of player paths for exec
  */
-void setup_process(Game *game, int id, char *playerPaths[]) {
+void setup_process(Task *task, int id, char *playerPaths[]) {
     int inputToPlayer[2], outputFromPlayer[2];
     pid_t childPID;
+    int span = trace_begin(TRACE_HUB, "setup_process", "%c", 'A' + id);
 
     // Create pipes
     if (pipe(inputToPlayer) == -1 || pipe(outputFromPlayer) == -1) {
         handle_exit(PROCESS_FAIL);
     }
+    if (options.cgroup != NULL && !make_cgroup(&task->costs[id],
+            options.cgroup, 'A' + id, options.cpuMax, options.memoryMax)) {
+        handle_exit(PROCESS_FAIL);
+    }
 
     if ((childPID = fork()) == -1) {
         handle_exit(PROCESS_FAIL);
@@ -239,12 +361,92 @@ void setup_process(Game *game, int id, char *playerPaths[]) {
     if (childPID == 0) {
         // Child Process
         setup_child_fork(inputToPlayer, outputFromPlayer, playerPaths[id],
-                game, id);
+                task, id);
     } else {
         // Parent process
-        setup_parent_fork(inputToPlayer, outputFromPlayer, game, id,
+        setup_parent_fork(inputToPlayer, outputFromPlayer, task, id,
                 childPID);
+        trace_name_track(TRACE_PLAYER(id), "Player %c %s", 'A' + id,
+                playerPaths[id]);
+        if (options.perfPlayers) {
+            perf_add_player(childPID, 'A' + id);
+        }
+        trace_end(span);
+    }
+}
+
+/*
+ * Waits for players to connect to the listening socket, seating them in
+ * the order they connect. Connected players have no pid.
+ *
+ * @param *task     the task whose game they play.
+ */
+void accept_players(Task *task) {
+    Game *game = task->game;
+    int server, client;
+    int span = trace_begin(TRACE_HUB, "accept_players", "");
+
+    if ((server = listen_socket(options.listen)) == -1) {
+        handle_exit(PROCESS_FAIL);
+    }
+    for (int i = 0; i < game->numPlayers; i++) {
+        if ((client = accept(server, NULL, NULL)) == -1) {
+            handle_exit(PROCESS_FAIL);
+        }
+        // Separate descriptors so each stream can be closed on its own
+        if ((game->players[i]->input = open_queue(client,
+                &task->outbound[i])) == NULL
+                || (game->players[i]->output = fdopen(dup(client), "r"))
+                == NULL) {
+            handle_exit(PROCESS_FAIL);
+        }
+        game->players[i]->pid = 0;
+        trace_name_track(TRACE_PLAYER(i), "Player %c %s", 'A' + i,
+                options.listen);
+    }
+    close(server);
+    unlink(options.listen);
+    trace_end(span);
+}
+
+/*
+ * Tells connected players a game is starting and which seat they have.
+ *
+ * @param *game     the game about to start.
+ */
+void start_connected_game(Game *game) {
+    char params[EXT_MSG_MAX_LEN];
+
+    for (int i = 0; i < game->numPlayers; i++) {
+        sprintf(params, "%d,%d,%d,%u", game->numPlayers, i,
+                game->numCarriages, game->seed);
+        if (game->numLevels != DEFAULT_LEVELS
+                || game->numRounds != DEFAULT_ROUNDS) {
+            sprintf(params + strlen(params), ",%d,%d", game->numLevels,
+                    game->numRounds);
+        }
+        send_message(game->players[i]->input, NEW_GAME, params);
+    }
+}
+
+/*
+ * Moves a task on to the next game for the same connected players, with
+ * the next seed.
+ *
+ * @param *task     the task, whose game just played is freed.
+ */
+void next_game(Task *task) {
+    Game *game = task->game;
+    Game *next = make_game(game->numPlayers, game->numCarriages,
+            game->numLevels, game->numRounds, game->seed + 1);
+
+    for (int i = 0; i < game->numPlayers; i++) {
+        next->players[i]->input = game->players[i]->input;
+        next->players[i]->output = game->players[i]->output;
+        next->players[i]->pid = game->players[i]->pid;
     }
+    free_game(game);
+    task->game = next;
 }
 
 /*
@@ -255,15 +457,22 @@ void setup_process(Game *game, int id, char *playerPaths[]) {
  * @return  true if all players have sent '!' ready signal, else false.
  */
 bool players_ready(Game *game) {
-    int handshake;
+    char handshake;
+    struct pollfd ready = {.events = POLLIN};
+    int span = trace_begin(TRACE_HUB, "players_ready", "");
+
     for (int i = 0; i < game->numPlayers; i++) {
-        handshake = fgetc(game->players[i]->output);
-        if (handshake != '!') {
+        // Read unbuffered, the event loop reads the pipe directly after.
+        // Sockets share the queue's descriptor, which doesn't block.
+        ready.fd = fileno(game->players[i]->output);
+        if (poll(&ready, 1, -1) != 1
+                || read(ready.fd, &handshake, 1) != 1
+                || handshake != '!') {
+            trace_end(span);
             return false;
         }
-        // Clear rest of pipe.
-        // handshake = fgetc(game->players[i]->output);
     }
+    trace_end(span);
     return true;
 }
 
@@ -272,6 +481,20 @@ bool players_ready(Game *game) {
  * Hub game functions
  * ===========================================================================
  */
+/*
+ * Tells players an action was run, unless options.deltas is set. Players
+ * then learn what it did from the next state message instead.
+ *
+ * @param *game     current game state.
+ * @param message   the action message.
+ * @param params    the player and any target or direction.
+ */
+void tell_players(Game *game, char *message, char *params) {
+    if (!options.deltas) {
+        message_all(game, message, params);
+    }
+}
+
 /*
  * Handles dry out instruction, sends execution phase message when done.
  *
@@ -280,7 +503,7 @@ bool players_ready(Game *game) {
  */
 void handle_dryout(Game *game, int id) {
     // Dry out player
-    game->players[id]->hits = 0;
+    change_hits(game, id, -game->players[id]->hits);
 
     // Update orders
     game->players[id]->orders[0] = DRY;
@@ -288,24 +511,26 @@ void handle_dryout(Game *game, int id) {
     // Update players
     char args[MAX_PARAMS] = {'\0'};
     args[0] = game->players[id]->symbol;
-    message_all(game, TELL_DRY, args);
+    tell_players(game, TELL_DRY, args);
 }
 
 /*
  * Handles looting instructions. Sends execution phase message when done.
  *
  * @param *game     current game state.
+ * @param *stats    the game's counts.
  * @param id        player id we are handling.
  */
-void handle_loot(Game *game, int id) {
+void handle_loot(Game *game, Stats *stats, int id) {
     // Current player position
     Position pos = game->players[id]->pos;
-    int width = game->numCarriages;
+    int index = train_index(game, pos.x, pos.y);
 
-    if (game->train[pos.y * width + pos.x] > 0) {
+    count_loot(stats, id, game->train[index] > 0);
+    if (game->train[index] > 0) {
         // found loot
-        game->train[pos.y * width + pos.x]--;
-        game->players[id]->loot++;
+        change_train(game, index, -1);
+        change_loot(game, id, 1);
     }
 
     // Update orders
@@ -314,7 +539,7 @@ void handle_loot(Game *game, int id) {
     // Message to players
     char args[MAX_PARAMS] = {'\0'};
     args[0] = game->players[id]->symbol;
-    message_all(game, TELL_LOOT, args);
+    tell_players(game, TELL_LOOT, args);
 }
 
 /*
@@ -322,9 +547,10 @@ void handle_loot(Game *game, int id) {
  * finalised.
  *
  * @param *game     the current game state.
+ * @param *stats    the game's counts.
  * @param id        player id we are handling
  */
-void handle_shot(Game *game, int id) {
+void handle_shot(Game *game, Stats *stats, int id) {
     // Player order
     char order = game->players[id]->newOrders[0];
     char param = game->players[id]->newOrders[1];
@@ -332,22 +558,28 @@ void handle_shot(Game *game, int id) {
     args[0] = game->players[id]->symbol;
     args[1] = param;
 
+    count_shot(stats, id, param != NO_TARGET);
     if (order == SHOOT_S && param != NO_TARGET) {
         // Target loses loot and train gains loot at position
         if (game->players[param - 'A']->loot > 0) {
-            game->players[param - 'A']->loot--;
+            count_drop(stats, param - 'A');
+            change_loot(game, param - 'A', -1);
             Position targetPos = game->players[param - 'A']->pos;
-            game->train[targetPos.y * game->numCarriages + targetPos.x]++;
+            change_train(game, train_index(game, targetPos.x, targetPos.y),
+                    1);
         }
-        message_all(game, TELL_SHORT, args);
+        tell_players(game, TELL_SHORT, args);
     } else if (order == SHOOT_L && param != NO_TARGET) {
-        game->players[param - 'A']->hits++;
-        message_all(game, TELL_LONG, args);
+        change_hits(game, param - 'A', 1);
+        tell_players(game, TELL_LONG, args);
     } else if (order == SHOOT_S && param == NO_TARGET) {
-        message_all(game, TELL_SHORT, args);
+        tell_players(game, TELL_SHORT, args);
     } else if (order == SHOOT_L && param == NO_TARGET) {
-        message_all(game, TELL_LONG, args);
+        tell_players(game, TELL_LONG, args);
     }
+
+    // Update orders, snapshots rely on these matching the players' view.
+    game->players[id]->orders[0] = order;
 }
 
 /*
@@ -366,45 +598,42 @@ void handle_movement(Game *game, int id) {
     // Arg storage for message sending
     char args[MAX_PARAMS] = {'\0'};
 
-    // Handle vertical
-    if (order == MOVE_V && pos.y == 0) {
-        game->players[id]->pos.y = 1;
-    } else if (order == MOVE_V && pos.y == 1) {
-        game->players[id]->pos.y = 0;
+    // Handle vertical, up a level or from the top to the bottom
+    if (order == MOVE_V) {
+        move_player(game, id, pos.x, next_level(game, pos.y));
     }
 
     // Handle horizontal
     if (order == MOVE_H && param == DIR_LEFT) {
-        game->players[id]->pos.x--;
+        move_player(game, id, pos.x - 1, pos.y);
     } else if (order == MOVE_H && param == DIR_RIGHT) {
-        game->players[id]->pos.x++;
+        move_player(game, id, pos.x + 1, pos.y);
     }
 
-    // Update past orders
+    // Update past orders, keeping the last horizontal direction.
     game->players[id]->orders[0] = order;
-    game->players[id]->orders[1] = param;
+    if (order == MOVE_H) {
+        game->players[id]->orders[1] = param;
+    }
 
     // Send message to all players
     args[0] = game->players[id]->symbol;
     if (order == MOVE_V) {
-        message_all(game, TELL_VMOVE, args);
+        tell_players(game, TELL_VMOVE, args);
     } else if (order == MOVE_H) {
         args[1] = param;
-        message_all(game, TELL_HMOVE, args);
+        tell_players(game, TELL_HMOVE, args);
     }
 }
 
 /*
- * Gathers/seeks further instructions.
+ * Asks a player for the direction or target of its order.
  *
  * @param *game     the hub's game state.
  * @param id        the player we are requesting additional info from.
  */
-void gather_instructions(Game *game, int id) {
-    char instruction[MSG_MAX_LEN], order;
-    order = game->players[id]->newOrders[0];
-
-    switch (order) {
+void request_instructions(Game *game, int id) {
+    switch (game->players[id]->newOrders[0]) {
         case MOVE_H:
             send_message(game->players[id]->input, GET_DIR, NULL);
             break;
@@ -415,143 +644,300 @@ void gather_instructions(Game *game, int id) {
             send_message(game->players[id]->input, GET_S_TARGET, NULL);
             break;
     }
+}
+
+/*
+ * Records the direction or target a player replied with.
+ *
+ * @param *game         the hub's game state.
+ * @param id            the player that replied.
+ * @param instruction   the player's reply.
+ * @return true if recorded, false if the reply breaks the protocol.
+ */
+bool receive_instructions(Game *game, int id, char instruction[]) {
+    if (!player_message_valid(instruction)) {
+        return false;
+    }
+    game->players[id]->newOrders[1] = instruction[strlen(instruction) - 1];
+    return true;
+}
 
-    if (fgets(instruction, MSG_MAX_LEN, game->players[id]->output) == NULL) {
-        handle_exit(PLAYER_CLOSED);
+/*
+ * Resolves the direction of a compound horizontal move. Directions that
+ * would leave the train turn around instead.
+ *
+ * @param *game     the hub's game state.
+ * @param id        the player whose move we are resolving.
+ */
+void resolve_direction(Game *game, int id) {
+    char policy = game->players[id]->policy;
+    char lastDirection = game->players[id]->orders[1];
+    int x = game->players[id]->pos.x;
+    char direction;
+
+    if (policy == KEEP_DIRECTION) {
+        // Keep going the way we went last, if the train allows.
+        policy = lastDirection;
+    }
+    if (policy == DIR_LEFT && x > 0) {
+        direction = DIR_LEFT;
+    } else if (policy == DIR_RIGHT && x < game->numCarriages - 1) {
+        direction = DIR_RIGHT;
+    } else if (x == 0) {
+        direction = DIR_RIGHT;
     } else {
-        // Clean up message
-        if (instruction[strlen(instruction) - 1] == '\n') {
-            instruction[strlen(instruction) - 1] = '\0';
+        direction = DIR_LEFT;
+    }
+    game->players[id]->newOrders[1] = direction;
+}
+
+/*
+ * Resolves the target of a compound shot against the current state.
+ * Falls back to no target if no player can be shot.
+ *
+ * @param *game     the hub's game state.
+ * @param id        the player whose shot we are resolving.
+ */
+void resolve_target(Game *game, int id) {
+    Player *shooter = game->players[id];
+    unsigned int targets = shooter->newOrders[0] == SHOOT_S
+            ? targets_here(game, id, shooter->legal.shortTargets)
+            : shooter->legal.longTargets;
+    int target = -1, distance, bestDistance = 0;
+
+    for (int i = 0; i < game->numPlayers && shooter->policy != NO_TARGET;
+            i++) {
+        if (!(targets >> i & 1)) {
+            continue;
+        }
+        distance = abs(game->players[i]->pos.x - shooter->pos.x);
+        if (target == -1 || shooter->policy == TARGET_HIGHEST
+                || (shooter->policy == TARGET_NEAREST
+                && distance < bestDistance)) {
+            target = i;
+            bestDistance = distance;
         }
     }
-    if (!player_message_valid(instruction)) {
-        handle_exit(PROTOCOL_ERROR);
+
+    if (target == -1) {
+        shooter->newOrders[1] = NO_TARGET;
     } else {
-        game->players[id]->newOrders[1] = instruction[strlen(instruction) - 1];
+        shooter->newOrders[1] = game->players[target]->symbol;
     }
 }
 
 /*
- * Execution phase, hub examines orders and requests more information
- * if appropriate, before sending instructions to players + updating state.
+ * Checks every order of the round is a real order before any is run.
  *
  * @param *game     the hub's view of game state.
+ * @return true if every order is real, false otherwise.
  */
-void execution_phase(Game *game) {
-    char order;
-    // Ensure all instructions are correct.
+bool check_orders(Game *game) {
     for (int i = 0; i < game->numPlayers; i++) {
-        order = game->players[i]->newOrders[0];
-        if (strchr(VALID_MOVES, order) == NULL) {
-            handle_exit(PROTOCOL_ERROR);
+        if (strchr(VALID_MOVES, game->players[i]->newOrders[0]) == NULL) {
+            return false;
         }
     }
+    return true;
+}
 
-    // Execute for each player.
-    for (int i = 0; i < game->numPlayers; i++) {
-        order = game->players[i]->newOrders[0];
-        if (order == MOVE_H || order == SHOOT_L || order == SHOOT_S) {
-            // Need further instructions
-            gather_instructions(game, i);
-        }
-        // Validate move is legal
-        if (!move_is_legal(game, i)) {
-            handle_exit(ILLEGAL_MOVE);
-        }
+/*
+ * Fills in the direction or target of an order from the player's
+ * policy, if it gave one.
+ *
+ * @param *game     the hub's view of game state.
+ * @param id        the player whose order is next to run.
+ * @return true if the player must be asked for the rest, else false.
+ */
+bool prepare_order(Game *game, int id) {
+    char order = game->players[id]->newOrders[0];
 
-        // Handle order and send message
-        if (order == MOVE_H || order == MOVE_V) {
-            handle_movement(game, i);
-        } else if (order == SHOOT_L || order == SHOOT_S) {
-            handle_shot(game, i);
-        } else if (order == LOOT) {
-            handle_loot(game, i);
-        } else if (order == DRY) {
-            handle_dryout(game, i);
-        }
+    // Earlier orders this round may have changed what is legal
+    find_legal(game, id, &game->players[id]->legal);
+
+    if (order == MOVE_H && game->players[id]->policy != NO_POLICY) {
+        // Player told us which way to go when ordering
+        resolve_direction(game, id);
+    } else if ((order == SHOOT_L || order == SHOOT_S)
+            && game->players[id]->policy != NO_POLICY) {
+        // Player told us how to pick a target when ordering
+        resolve_target(game, id);
+    } else if (order == MOVE_H || order == SHOOT_L || order == SHOOT_S) {
+        // Need further instructions
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Runs a complete order, updating state and telling players.
+ *
+ * @param *game     the hub's view of game state.
+ * @param *stats    the game's counts.
+ * @param id        the player whose order is run.
+ * @return true if run, false if the order is illegal.
+ */
+bool execute_order(Game *game, Stats *stats, int id) {
+    char order = game->players[id]->newOrders[0];
 
+    // Validate move is legal
+    if (!order_is_legal(&game->players[id]->legal, order,
+            game->players[id]->newOrders[1])) {
+        return false;
+    }
+    count_action(stats, id, order);
+
+    // Handle order and send message
+    if (order == MOVE_H || order == MOVE_V) {
+        handle_movement(game, id);
+    } else if (order == SHOOT_L || order == SHOOT_S) {
+        handle_shot(game, stats, id);
+    } else if (order == LOOT) {
+        handle_loot(game, stats, id);
+    } else if (order == DRY) {
+        handle_dryout(game, id);
     }
+    return true;
 }
 
 /*
- * Requests an order from the player, non execution phase.
- * Expects some kind of playX order, then sends order to players.
+ * Records the order a player sent in response to 'yourturn'.
  *
  * @param *game     the current game state according to the hub.
+ * @param id        the player whose order we are receiving.
+ * @param message   the player's reply.
+ * @return true if recorded, false if the reply breaks the protocol.
  */
-void request_player_action(Game *game) {
-    char message[MSG_MAX_LEN], params[MAX_PARAMS] = {'\0'};
-
-    for (int i = 0; i < game->numPlayers; i++) {
-        // If player needs to dry out, no need for instructions.
-        if (game->players[i]->hits >= 3) {
-            game->players[i]->newOrders[0] = DRY;
-            continue;
-        }
-        // Tell player 'yourturn'
-        send_message(game->players[i]->input, GET_ACTION, NULL);
-        // Listen for response
-        if (fgets(message, MSG_MAX_LEN, game->players[i]->output) == NULL) {
-            handle_exit(PLAYER_CLOSED);
-        } else {
-            // Clean up message
-            if (message[strlen(message) - 1] == '\n') {
-                message[strlen(message) - 1] = '\0';
-            }
-        }
+bool receive_order(Game *game, int id, char message[]) {
+    char order, policy = NO_POLICY;
+    int length;
 
-        // Process message
-        if (!player_message_valid(message)) {
-            handle_exit(PROTOCOL_ERROR);
-        } else {
-            // Update orders
-            game->players[i]->newOrders[0] = message[strlen(message) - 1];
-            params[0] = game->players[i]->symbol;
-            params[1] = game->players[i]->newOrders[0];
-            message_all(game, ORDERED, params);
+    // Process message
+    if (!player_message_valid(message)) {
+        return false;
+    }
+    if (strncmp(message, PLAN, strlen(PLAN)) == 0) {
+        // Plan must give an order for this round too
+        return receive_plan(game, id, message) && follow_plan(game, id);
+    }
+    length = strlen(message);
+    order = message[length - 1];
+    if (length == strlen(PLAY) + 2) {
+        // Compound order, policy must suit the order type
+        order = message[length - 2];
+        policy = message[length - 1];
+        if (!policy_valid(order, policy)) {
+            return false;
         }
     }
+    game->players[id]->newOrders[0] = order;
+    game->players[id]->policy = policy;
+    return true;
 }
 
 /*
- * Hub game loop to run game.
+ * Stores a plan sent by a player, covering this round onwards.
  *
- * @param *game     the game state and data
+ * @param *game     the current game state according to the hub.
+ * @param id        the player who sent the plan.
+ * @param message   the plan message, already checked for format.
+ * @return true if stored, false if a rule breaks the protocol.
  */
-void hub_game_loop(Game *game) {
-    while(1) {
-        if (game->round > 15) {
-            // End of game!
-            determine_winners(game);
-            message_all(game, GAME_OVER, NULL);
-            // winner function
-            handle_exit(EXIT_SUCCESS);
+bool receive_plan(Game *game, int id, char message[]) {
+    Plan *plan = &game->players[id]->plan;
+    char *rules, *rule;
+    int rounds;
+
+    rounds = strtol(message + strlen(PLAN), &rules, 10);
+    // Skip the separator between round count and rules
+    rules++;
+    plan->lastRound = game->round + rounds - 1;
+    plan->numRules = strlen(rules) / 3;
+
+    for (int i = 0; i < plan->numRules; i++) {
+        rule = rules + i * 3;
+        if (strchr(VALID_PREDICATES, rule[0]) == NULL
+                || strchr(VALID_MOVES, rule[1]) == NULL
+                || (rule[2] != PLAN_NO_POLICY
+                && !policy_valid(rule[1], rule[2]))) {
+            return false;
         }
+        memcpy(plan->rules[i], rule, 3);
+    }
+    return true;
+}
 
-        // Indicate a new round
-        game->round++;
-        game->execute = false;
-        message_all(game, NEW_ROUND, NULL);
-
-        // Get player action
-        request_player_action(game);
-
-        // Execution phase
-        game->execute = true;
-        message_all(game, EXECUTE, NULL);
-        execution_phase(game);
+/*
+ * Checks whether a plan rule predicate holds for a player.
+ *
+ * @param *game     the current game state according to the hub.
+ * @param id        the player the plan belongs to.
+ * @param predicate the predicate of the rule.
+ * @return true if the predicate holds, else false.
+ */
+bool rule_holds(Game *game, int id, char predicate) {
+    Position pos = game->players[id]->pos, checkPos;
+
+    switch (predicate) {
+        case WHEN_LOOT:
+            return game->train[train_index(game, pos.x, pos.y)] > 0;
+        case WHEN_PLAYER:
+            for (int i = 0; i < game->numPlayers; i++) {
+                checkPos = game->players[i]->pos;
+                if (i != id && checkPos.x == pos.x && checkPos.y == pos.y) {
+                    return true;
+                }
+            }
+            return false;
+        case WHEN_LEFT_END:
+            return pos.x == 0;
+        case WHEN_RIGHT_END:
+            return pos.x == game->numCarriages - 1;
+        case WHEN_UPPER:
+            return pos.y > 0;
+        case WHEN_LOWER:
+            return pos.y == 0;
+    }
+    // Always
+    return true;
+}
 
-        // Print game summary
-        print_game_state(game);
+/*
+ * Orders on behalf of a player using the first rule of its plan that
+ * holds. Plans that are spent or have no rule holding are dropped, so
+ * that the player is asked instead.
+ *
+ * @param *game     the current game state according to the hub.
+ * @param id        the player we are ordering for.
+ * @return true if the plan gave an order, else false.
+ */
+bool follow_plan(Game *game, int id) {
+    Player *player = game->players[id];
+    Plan *plan = &player->plan;
+    char *rule;
+
+    for (int i = 0; i < plan->numRules && game->round <= plan->lastRound;
+            i++) {
+        rule = plan->rules[i];
+        if (rule_holds(game, id, rule[0])) {
+            player->newOrders[0] = rule[1];
+            player->policy = rule[2] == PLAN_NO_POLICY ? NO_POLICY : rule[2];
+            return true;
+        }
     }
+
+    // Plan no longer tells us what to do
+    plan->numRules = 0;
+    return false;
 }
 
 /*
  * Reports the winners of the game.
  *
  * @param *game     game state according to hub.
+ * @param out       stream the game is printed to.
  */
-void determine_winners(Game *game) {
+void determine_winners(Game *game, FILE *out) {
     int mostLoot = 0;
     char winners[game->numPlayers];
     int numWinners = 0;
@@ -571,111 +957,1450 @@ void determine_winners(Game *game) {
     }
 
     // Report winners
-    printf("Winner(s):");
-    for (int i = 0; i < numWinners; i++) {
-        printf("%c", winners[i]);
-        if (i == numWinners - 1) {
-            printf("\n");
-        } else {
-            printf(",");
-        }
+    print_winners(out, options.format, winners, numWinners);
+    fflush(out);
+    if (record != NULL) {
+        print_winners(record, options.format, winners, numWinners);
     }
 }
 
 /*
- * Prints the current game state teo terminal/stdout.
+ * Reports the game state after a round, if the round is sampled.
+ * The final round is always reported.
  *
- * @param *game     game data that state will be drawn from.
+ * @param *game     game state according to hub.
+ * @param out       stream the game is printed to.
  */
-void print_game_state(Game *game) {
-    // Print player status
-    for (int i = 0; i < game->numPlayers; i++) {
-        printf("%c@(%d,%d): $=%d hits=%d\n", game->players[i]->symbol,
-                game->players[i]->pos.x, game->players[i]->pos.y,
-                game->players[i]->loot, game->players[i]->hits);
-        fflush(stdout);
+void report_round(Game *game, FILE *out) {
+    int played = game->round - 1;
+
+    if (played % options.every == 0 || game->round > game->numRounds) {
+        print_game_state(game, out, options.format);
+        fflush(out);
+        if (record != NULL) {
+            print_game_state(game, record, options.format);
+        }
     }
+}
 
-    // Print train status/loot remaining.
-    for (int i = 0; i < game->numCarriages; i++) {
-        printf("Carriage %d: $=%d : $=%d\n", i, game->train[i],
-                game->train[game->numCarriages + i]);
-        fflush(stdout);
+/*
+ * ===========================================================================
+ * Hub outbound queue functions
+ * ===========================================================================
+ */
+/*
+ * Makes the stream messages to a player are written to. Its writes are
+ * queued for the player instead of waiting for it to read them.
+ *
+ * @param fd        the player's end of its pipe or socket.
+ * @param **queue   where to store the player's queue.
+ * @return the stream, or NULL if it couldn't be made.
+ */
+FILE *open_queue(int fd, Queue **queue) {
+    cookie_io_functions_t functions = {.write = queue_write,
+            .close = queue_close};
+    int flags;
+
+    if ((flags = fcntl(fd, F_GETFL)) == -1
+            || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        return NULL;
     }
+    *queue = (Queue *) calloc(1, sizeof(Queue));
+    (*queue)->fd = fd;
+    return fopencookie(*queue, "w", functions);
 }
 
 /*
- * Initialises game, after checking arguments are correct.
+ * Queues bytes flushed from a player's stream, sending what the player
+ * will take straight away. Passing the queue limit closes the queue.
  *
- * @param argc      count of arguments provided
- * @param argv      array of pointers to arguments provided
- * @return Game struct with game info and players.
+ * @param *cookie   the player's queue.
+ * @param buffer    the bytes flushed.
+ * @param size      how many bytes were flushed.
+ * @return size, bytes for closed queues are dropped.
  */
-Game *init_args(int argc, char **argv) {
-    int numPlayers, numCarriages;
-    unsigned int seed;
-
-    // Check we an acceptable number of arguments.
-    if (argc < (3 + MIN_PLAYERS)) {
-        handle_exit(WRONG_ARGS);
+ssize_t queue_write(void *cookie, const char *buffer, size_t size) {
+    Queue *queue = (Queue *) cookie;
+
+    // The event loop finds closed queues and ends the game
+    if (queue->closed || queue->length - queue->sent + size
+            > (size_t) options.queueLimit) {
+        queue->closed = true;
+        return size;
     }
-    // Check that seed and carriage arguments are numbers.
-    if (!arg_is_number(argv[1]) || !arg_is_number(argv[2])) {
-        handle_exit(INVALID_ARG);
+    if (queue->length + size > queue->capacity) {
+        // Sent bytes make room first, then the queue grows
+        memmove(queue->data, queue->data + queue->sent,
+                queue->length - queue->sent);
+        queue->length -= queue->sent;
+        queue->sent = 0;
+        while (queue->length + size > queue->capacity) {
+            queue->capacity = queue->capacity == 0 ? QUEUE_START_SIZE
+                    : queue->capacity * 2;
+        }
+        queue->data = (char *) realloc(queue->data, queue->capacity);
     }
+    memcpy(queue->data + queue->length, buffer, size);
+    queue->length += size;
+    send_queued(queue);
+    return size;
+}
 
-    // Extract number arguments for game.
-    char *temp;
-    numPlayers = argc - 3;
-    seed = strtoul(argv[1], &temp, 10);
-    numCarriages = strtol(argv[2], &temp, 10);
-    // Final check for arguments
-    if (numPlayers < MIN_PLAYERS || numPlayers > MAX_PLAYERS ||
-            numCarriages < MIN_CARRIAGES) {
-        handle_exit(INVALID_ARG);
-    }
+/*
+ * Closes a player's stream, dropping anything still queued.
+ *
+ * @param *cookie   the player's queue.
+ * @return 0 if closed, -1 otherwise.
+ */
+int queue_close(void *cookie) {
+    Queue *queue = (Queue *) cookie;
+
+    // The queue stays with its task, closed and empty
+    queue->closed = true;
+    free(queue->data);
+    queue->data = NULL;
+    queue->sent = queue->length = queue->capacity = 0;
+    return close(queue->fd);
+}
 
-    // Initialise game struct
-    Game *game = make_game(numPlayers, numCarriages, seed);
-    globalPlayers = (Player **) malloc(sizeof(Player *) * numPlayers);
-    for (int i = 0; i < numPlayers; i++) {
-        globalPlayers[i] = (Player *) malloc(sizeof(Player) * numPlayers);
+/*
+ * Sends as much of a queue as the player will take without waiting. The
+ * queue is closed if the player can no longer be written to.
+ *
+ * @param *queue    the queue to send.
+ */
+void send_queued(Queue *queue) {
+    ssize_t wrote;
+
+    while (queue_pending(queue)) {
+        wrote = write(queue->fd, queue->data + queue->sent,
+                queue->length - queue->sent);
+        if (wrote > 0) {
+            queue->sent += wrote;
+        } else if (wrote == -1 && (errno == EAGAIN
+                || errno == EWOULDBLOCK)) {
+            return;
+        } else if (wrote == 0 || errno != EINTR) {
+            queue->closed = true;
+        }
+    }
+    if (queue->sent == queue->length) {
+        queue->sent = queue->length = 0;
     }
-
-    return game;
 }
 
-int main(int argc, char **argv) {
-    // Main signal handler
-    struct sigaction sa;
-    sa.sa_handler = &handle_sig;
-    sa.sa_flags = SA_RESTART;
-    // Handle SIGINT
-    sigaction(SIGINT, &sa, NULL);
+/*
+ * Checks if a queue has bytes left to send.
+ *
+ * @param *queue    the queue, NULL if the player has none.
+ * @return true if bytes are waiting and the queue is open, else false.
+ */
+bool queue_pending(Queue *queue) {
+    return queue != NULL && !queue->closed && queue->sent < queue->length;
+}
 
-    // Ignore these signals
-    struct sigaction saIgnore;
-    saIgnore.sa_handler = SIG_IGN;
-    saIgnore.sa_flags = SA_RESTART;
-    sigaction(SIGPIPE, &saIgnore, NULL);
+/*
+ * Waits for the players of a task to take what is queued for them, giving
+ * each up to timeout milliseconds between writes.
+ *
+ * @param *task     the task whose queues are drained.
+ * @param timeout   milliseconds to wait for a player to take more.
+ */
+void drain_queues(Task *task, int timeout) {
+    struct pollfd ready = {.events = POLLOUT};
+    Queue *queue;
+
+    for (int i = 0; i < task->game->numPlayers; i++) {
+        queue = task->outbound[i];
+        ready.fd = queue == NULL ? -1 : queue->fd;
+        while (queue_pending(queue) && poll(&ready, 1, timeout) == 1) {
+            send_queued(queue);
+        }
+    }
+}
 
-    Game *game = init_args(argc, argv);
+/*
+ * ===========================================================================
+ * Hub task functions. Each game is a task that runs as much of a round as
+ * it can, then hands back to the event loop until its players reply.
+ * ===========================================================================
+ */
+/*
+ * Makes a task to run a game, before its players are seated. Tasks last
+ * until the hub exits, which shuts down every task's players.
+ *
+ * @param *game     the game to run.
+ * @param out       stream the game is printed to.
+ * @return the task, to be started once its players are ready.
+ */
+Task *make_task(Game *game, FILE *out) {
+    Task *task = (Task *) malloc(sizeof(Task));
+
+    task->game = game;
+    task->status = EXIT_SUCCESS;
+    task->out = out;
+    task->outbound = (Queue **) calloc(game->numPlayers, sizeof(Queue *));
+    task->costs = (Cost *) calloc(game->numPlayers, sizeof(Cost));
+    task->waiting = (bool *) calloc(game->numPlayers, sizeof(bool));
+    task->outOfSync = (bool *) calloc(game->numPlayers, sizeof(bool));
+    task->lines = (Line *) calloc(game->numPlayers, sizeof(Line));
+    task->spans = (int *) calloc(game->numPlayers, sizeof(int));
+    task->seen = NULL;
+
+    playing = (Task **) realloc(playing, sizeof(Task *) * (numPlaying + 1));
+    playing[numPlaying++] = task;
+    return task;
+}
 
-    // Extract player paths
-    char *playerPaths[game->numPlayers];
-    for (int i = 3; i < argc; i++) {
-        playerPaths[i - 3] = argv[i];
+/*
+ * Readies a task to play its game from the next round, once its players
+ * are ready and have been told of any resumed state.
+ *
+ * @param *task     the task to start.
+ */
+void start_task(Task *task) {
+    Game *game = task->game;
+
+    task->step = STEP_ROUND;
+    task->next = 0;
+    task->numWaiting = 0;
+    memset(task->waiting, 0, sizeof(bool) * game->numPlayers);
+    memset(task->lines, 0, sizeof(Line) * game->numPlayers);
+    reset_stats(&task->stats, game);
+    if (task->seen != NULL) {
+        free_game(task->seen);
+        task->seen = NULL;
+    }
+    if (options.deltas) {
+        // Players start out seeing the game as it is
+        task->seen = make_game(game->numPlayers, game->numCarriages,
+                game->numLevels, game->numRounds, game->seed);
+        copy_view(task->seen, game);
     }
+}
 
-    // Setup players
-    for (int i = 0; i < game->numPlayers; i++) {
-        setup_process(game, i, playerPaths);
+/*
+ * Ends a task whose player broke the game, keeping the first reason for
+ * when the game is reported. Its players are shut down at exit.
+ *
+ * @param *task     the task to end.
+ * @param status    why, one of the player error exit codes.
+ */
+void fail_task(Task *task, int status) {
+    if (task->status == EXIT_SUCCESS) {
+        task->status = status;
     }
-    if (!players_ready(game)) {
-        handle_exit(PROCESS_FAIL);
+    task->step = STEP_DONE;
+    task->numWaiting = 0;
+    memset(task->waiting, 0, sizeof(bool) * task->game->numPlayers);
+}
+
+/*
+ * Notes that a task can't go on until a player replies.
+ *
+ * @param *task     the task waiting.
+ * @param id        the player the task is waiting on.
+ */
+void wait_for(Task *task, int id) {
+    task->waiting[id] = true;
+    task->numWaiting++;
+}
+
+/*
+ * Starts the next round, or ends the game once every round is played.
+ *
+ * @param *task     the task running the game.
+ */
+void start_round(Task *task) {
+    Game *game = task->game;
+
+    if (game->round > game->numRounds) {
+        // End of game!
+        determine_winners(game, task->out);
+        message_all(game, GAME_OVER, NULL);
+        task->step = STEP_DONE;
+        return;
+    }
+
+    // Indicate a new round
+    game->round++;
+    game->execute = false;
+    task->roundSpan = trace_begin(TRACE_HUB, "round", "%d", game->round - 1);
+    perf_phase(PERF_ORDERS);
+    message_all(game, NEW_ROUND, NULL);
+    task->next = 0;
+    task->step = STEP_ORDERS;
+}
+
+/*
+ * Tells all players the order a player made.
+ *
+ * @param *game     the current game state according to the hub.
+ * @param id        the player who made the order.
+ */
+void announce_order(Game *game, int id) {
+    char params[MAX_PARAMS] = {'\0'};
+
+    params[0] = game->players[id]->symbol;
+    params[1] = game->players[id]->newOrders[0];
+    message_all(game, ORDERED, params);
+}
+
+/*
+ * Tells a player it is their turn to order, with their legal actions if
+ * options.masks is set.
+ *
+ * @param *game     the current game state according to the hub.
+ * @param id        the player to order.
+ */
+void send_turn(Game *game, int id) {
+    char params[LEGAL_PARAMS_LEN];
+
+    if (!options.masks) {
+        send_message(game->players[id]->input, GET_ACTION, NULL);
+        return;
+    }
+    find_legal(game, id, &game->players[id]->legal);
+    legal_params(&game->players[id]->legal, params);
+    send_message(game->players[id]->input, GET_ACTION, params);
+}
+
+/*
+ * Requests orders from players one at a time, non execution phase.
+ * Each order is sent to all players before the next player is asked.
+ * Stops at the first player that has to be asked.
+ *
+ * @param *task     the task running the game.
+ */
+void request_player_action(Task *task) {
+    Game *game = task->game;
+    int id;
+
+    for (; task->next < game->numPlayers; task->next++) {
+        id = task->next;
+        // If player needs to dry out, no need for instructions.
+        if (game->players[id]->hits >= 3) {
+            game->players[id]->newOrders[0] = DRY;
+            continue;
+        }
+        // Tell player 'yourturn', unless its plan has the answer.
+        if (!follow_plan(game, id)) {
+            task->spans[id] = trace_begin(TRACE_PLAYER(id),
+                    "request_player_action", "");
+            send_turn(game, id);
+            wait_for(task, id);
+            return;
+        }
+        announce_order(game, id);
+    }
+    task->step = STEP_EXECUTE;
+}
+
+/*
+ * Requests orders from all players at once. Orders are broadcast
+ * together once all replies are in.
+ *
+ * @param *task     the task running the game.
+ */
+void request_simultaneous_action(Task *task) {
+    Game *game = task->game;
+
+    // Tell every player that isn't drying out or planned 'yourturn'
+    for (int i = 0; i < game->numPlayers; i++) {
+        if (game->players[i]->hits >= 3) {
+            game->players[i]->newOrders[0] = DRY;
+        } else if (!follow_plan(game, i)) {
+            task->spans[i] = trace_begin(TRACE_PLAYER(i),
+                    "request_player_action", "");
+            send_turn(game, i);
+            wait_for(task, i);
+        }
+    }
+    task->step = STEP_ANNOUNCE;
+}
+
+/*
+ * Sends all orders of a simultaneous round to players, in one write per
+ * player.
+ *
+ * @param *task     the task running the game.
+ */
+void announce_orders(Task *task) {
+    Game *game = task->game;
+    char params[MAX_PARAMS] = {'\0'};
+
+    for (int i = 0; i < game->numPlayers; i++) {
+        if (game->players[i]->hits < 3) {
+            params[0] = game->players[i]->symbol;
+            params[1] = game->players[i]->newOrders[0];
+            buffer_all(game, ORDERED, params);
+        }
+    }
+    flush_all(game);
+    task->step = STEP_EXECUTE;
+}
+
+/*
+ * Starts the execution phase once every order is in.
+ *
+ * @param *task     the task running the game.
+ */
+void start_execution(Task *task) {
+    Game *game = task->game;
+
+    perf_phase(PERF_EXECUTE);
+    game->execute = true;
+    message_all(game, EXECUTE, NULL);
+    // Ensure all instructions are correct.
+    if (!check_orders(game)) {
+        fail_task(task, PROTOCOL_ERROR);
+        return;
+    }
+    task->next = 0;
+    task->step = STEP_RUN_ORDERS;
+}
+
+/*
+ * Execution phase, runs orders in player order, asking players for
+ * further instructions if their order needs them. Stops at the first
+ * player that has to be asked.
+ *
+ * @param *task     the task running the game.
+ */
+void execution_phase(Task *task) {
+    Game *game = task->game;
+    char order;
+    int id;
+
+    for (; task->next < game->numPlayers; task->next++) {
+        id = task->next;
+        order = game->players[id]->newOrders[0];
+        task->stepSpan = trace_begin(TRACE_PLAYER(id),
+                "execution_phase", "%c", order);
+        if (prepare_order(game, id)) {
+            task->spans[id] = trace_begin(TRACE_PLAYER(id),
+                    "gather_instructions", "%c", order);
+            if (options.deltas) {
+                // The player must see earlier orders before it answers
+                send_changes(game, task->seen);
+            }
+            request_instructions(game, id);
+            wait_for(task, id);
+            return;
+        }
+        if (!execute_order(game, &task->stats, id)) {
+            fail_task(task, ILLEGAL_MOVE);
+            return;
+        }
+        trace_end(task->stepSpan);
+    }
+    if (options.deltas) {
+        send_changes(game, task->seen);
+    }
+    task->step = STEP_SYNC;
+}
+
+/*
+ * Asks every player for its game hash, if this round is checked.
+ *
+ * @param *task     the task running the game.
+ */
+void request_sync(Task *task) {
+    Game *game = task->game;
+
+    task->step = STEP_REPORT;
+    if (options.sync == 0 || (game->round - 1) % options.sync != 0) {
+        return;
+    }
+    task->stepSpan = trace_begin(TRACE_HUB, "sync", "%d", game->round - 1);
+    perf_phase(PERF_SYNC);
+    // Ask everyone at once, then compare replies.
+    message_all(game, SYNC, NULL);
+    for (int i = 0; i < game->numPlayers; i++) {
+        task->outOfSync[i] = false;
+        wait_for(task, i);
+    }
+    task->step = STEP_CHECK_SYNC;
+}
+
+/*
+ * Compares a player's game hash with the hub's.
+ *
+ * @param *task     the task running the game.
+ * @param id        the player that replied.
+ * @param message   the player's reply.
+ */
+void receive_hash(Task *task, int id, char message[]) {
+    if (!player_message_valid(message)
+            || strncmp(message, HASH, strlen(HASH)) != 0) {
+        fail_task(task, PROTOCOL_ERROR);
+        return;
+    }
+    task->outOfSync[id] = strtoull(message + strlen(HASH), NULL, 16)
+            != task->game->hash;
+}
+
+/*
+ * Checks every player's game hash matched the hub's, failing the task if
+ * not.
+ *
+ * @param *task     the task running the game.
+ */
+void check_sync(Task *task) {
+    Game *game = task->game;
+    bool synced = true;
+
+    trace_end(task->stepSpan);
+    for (int i = 0; i < game->numPlayers; i++) {
+        if (task->outOfSync[i]) {
+            fprintf(stderr, "Player %c out of sync in round %d\n",
+                    game->players[i]->symbol, game->round - 1);
+            synced = false;
+        }
+    }
+    if (!synced) {
+        fail_task(task, DESYNC);
+        return;
+    }
+    task->step = STEP_REPORT;
+}
+
+/*
+ * Ends a round, printing the game summary and saving a snapshot.
+ *
+ * @param *task     the task running the game.
+ */
+void finish_round(Task *task) {
+    count_round(&task->stats, task->game);
+    perf_phase(PERF_REPORT);
+    report_round(task->game, task->out);
+    if (options.snapshot != NULL
+            && !save_snapshot(task->game, options.snapshot)) {
+        fprintf(stderr, "Unable to save snapshot\n");
+    }
+    perf_round(task->game->round - 1);
+    trace_end(task->roundSpan);
+    task->step = STEP_ROUND;
+}
+
+/*
+ * Runs the current step of a task, which has no replies outstanding.
+ *
+ * @param *task     the task to run.
+ */
+void run_step(Task *task) {
+    switch (task->step) {
+        case STEP_ROUND:
+            start_round(task);
+            break;
+        case STEP_ORDERS:
+            if (options.simultaneous) {
+                request_simultaneous_action(task);
+            } else {
+                request_player_action(task);
+            }
+            break;
+        case STEP_ANNOUNCE:
+            announce_orders(task);
+            break;
+        case STEP_EXECUTE:
+            start_execution(task);
+            break;
+        case STEP_RUN_ORDERS:
+            execution_phase(task);
+            break;
+        case STEP_SYNC:
+            request_sync(task);
+            break;
+        case STEP_CHECK_SYNC:
+            check_sync(task);
+            break;
+        case STEP_REPORT:
+            finish_round(task);
+            break;
+    }
+}
+
+/*
+ * Hands a player's reply to the step that was waiting on it.
+ *
+ * @param *task     the task waiting on the player.
+ * @param id        the player that replied.
+ * @param message   the player's reply.
+ */
+void deliver_message(Task *task, int id, char message[]) {
+    Game *game = task->game;
+
+    task->waiting[id] = false;
+    task->numWaiting--;
+    switch (task->step) {
+        case STEP_ORDERS:
+            // One at a time, everyone hears the order before the next
+            if (!receive_order(game, id, message)) {
+                fail_task(task, PROTOCOL_ERROR);
+                return;
+            }
+            trace_end(task->spans[id]);
+            announce_order(game, id);
+            task->next++;
+            break;
+        case STEP_ANNOUNCE:
+            if (!receive_order(game, id, message)) {
+                fail_task(task, PROTOCOL_ERROR);
+                return;
+            }
+            trace_end(task->spans[id]);
+            break;
+        case STEP_RUN_ORDERS:
+            if (!receive_instructions(game, id, message)) {
+                fail_task(task, PROTOCOL_ERROR);
+                return;
+            }
+            trace_end(task->spans[id]);
+            if (!execute_order(game, &task->stats, id)) {
+                fail_task(task, ILLEGAL_MOVE);
+                return;
+            }
+            trace_end(task->stepSpan);
+            task->next++;
+            break;
+        case STEP_CHECK_SYNC:
+            receive_hash(task, id, message);
+            break;
+    }
+}
+
+/*
+ * Reads whatever a player has sent so far, failing the task if the player
+ * has closed.
+ *
+ * @param *task     the task the player belongs to.
+ * @param id        the player to read from.
+ */
+void read_player(Task *task, int id) {
+    Line *line = &task->lines[id];
+    ssize_t got;
+
+    got = read(fileno(task->game->players[id]->output),
+            line->text + line->length, EXT_MSG_MAX_LEN - 1 - line->length);
+    if (got <= 0) {
+        fail_task(task, PLAYER_CLOSED);
+        return;
+    }
+    line->length += got;
+}
+
+/*
+ * Takes the first whole message read from a player, if there is one.
+ * Messages too long for the buffer are taken as they are.
+ *
+ * @param *task     the task the player belongs to.
+ * @param id        the player the message is from.
+ * @param message   buffer of EXT_MSG_MAX_LEN to store the message in.
+ * @return true if a message was taken, else false.
+ */
+bool take_message(Task *task, int id, char message[]) {
+    Line *line = &task->lines[id];
+    char *end = memchr(line->text, '\n', line->length);
+    int length;
+
+    if (end == NULL && line->length < EXT_MSG_MAX_LEN - 1) {
+        return false;
+    }
+    length = end == NULL ? line->length : end - line->text;
+    memcpy(message, line->text, length);
+    message[length] = '\0';
+
+    // Drop the message and its newline from the buffer
+    if (end != NULL) {
+        length++;
+    }
+    line->length -= length;
+    memmove(line->text, line->text + length, line->length);
+    return true;
+}
+
+/*
+ * Runs a task until it is finished or waiting on a reply that hasn't
+ * been read yet.
+ *
+ * @param *task     the task to run.
+ */
+void advance_task(Task *task) {
+    char message[EXT_MSG_MAX_LEN];
+    bool replied;
+
+    while (task->step != STEP_DONE) {
+        if (task->numWaiting == 0) {
+            run_step(task);
+            continue;
+        }
+        // Replies may have been read along with earlier ones
+        replied = false;
+        for (int i = 0; i < task->game->numPlayers && !replied; i++) {
+            if (task->waiting[i] && take_message(task, i, message)) {
+                deliver_message(task, i, message);
+                replied = true;
+            }
+        }
+        if (!replied) {
+            return;
+        }
+    }
+}
+
+/*
+ * Fails a task if one of its players has stopped taking messages.
+ *
+ * @param *task     the task to check.
+ */
+void check_queues(Task *task) {
+    for (int i = 0; i < task->game->numPlayers; i++) {
+        if (task->outbound[i] != NULL && task->outbound[i]->closed) {
+            fail_task(task, PLAYER_CLOSED);
+            return;
+        }
+    }
+}
+
+/*
+ * Event loop, runs tasks on this thread until every game is over. Only
+ * players a task is waiting on are listened to, and only players with
+ * messages queued are written to.
+ *
+ * @param *tasks    the tasks to run.
+ * @param numTasks  the number of tasks.
+ */
+void run_tasks(Task *tasks[], int numTasks) {
+    int maxFds = 0, numFds, running;
+
+    // Each player may be both read from and written to
+    for (int i = 0; i < numTasks; i++) {
+        maxFds += tasks[i]->game->numPlayers * 2;
+    }
+    struct pollfd fds[maxFds];
+    Task *owners[maxFds];
+    int ids[maxFds];
+
+    do {
+        numFds = 0;
+        running = 0;
+        for (int i = 0; i < numTasks; i++) {
+            advance_task(tasks[i]);
+            if (tasks[i]->step != STEP_DONE) {
+                check_queues(tasks[i]);
+            }
+            if (tasks[i]->step == STEP_DONE) {
+                continue;
+            }
+            running++;
+            for (int j = 0; j < tasks[i]->game->numPlayers; j++) {
+                if (tasks[i]->waiting[j]) {
+                    fds[numFds].fd =
+                            fileno(tasks[i]->game->players[j]->output);
+                    fds[numFds].events = POLLIN;
+                    owners[numFds] = tasks[i];
+                    ids[numFds++] = j;
+                }
+                if (queue_pending(tasks[i]->outbound[j])) {
+                    fds[numFds].fd = tasks[i]->outbound[j]->fd;
+                    fds[numFds].events = POLLOUT;
+                    owners[numFds] = tasks[i];
+                    ids[numFds++] = j;
+                }
+            }
+        }
+        // Interrupted polls just go around again
+        if (running > 0 && poll(fds, numFds, -1) > 0) {
+            for (int i = 0; i < numFds; i++) {
+                if (fds[i].revents == 0) {
+                    continue;
+                } else if (fds[i].events == POLLOUT) {
+                    send_queued(owners[i]->outbound[ids[i]]);
+                } else {
+                    read_player(owners[i], ids[i]);
+                }
+            }
+        }
+    } while (running > 0);
+}
+
+/*
+ * Reads optional flags that precede the seed into the hub options.
+ *
+ * @param argc      count of arguments provided
+ * @param argv      array of pointers to arguments provided
+ * @return number of arguments consumed by flags.
+ */
+int parse_options(int argc, char **argv) {
+    struct option longOptions[] = {
+        {"simultaneous", no_argument, NULL, 's'},
+        {"format", required_argument, NULL, 'f'},
+        {"every", required_argument, NULL, 'e'},
+        {"trace", required_argument, NULL, 't'},
+        {"sync", required_argument, NULL, 'y'},
+        {"snapshot", required_argument, NULL, 'w'},
+        {"resume", required_argument, NULL, 'r'},
+        {"listen", required_argument, NULL, 'l'},
+        {"games", required_argument, NULL, 'n'},
+        {"daemon", required_argument, NULL, 'd'},
+        {"jobs", required_argument, NULL, 'j'},
+        {"masks", no_argument, NULL, 'm'},
+        {"deltas", no_argument, NULL, 'u'},
+        {"cache", required_argument, NULL, 'c'},
+        {"levels", required_argument, NULL, 'v'},
+        {"rounds", required_argument, NULL, 'o'},
+        {"scenario", required_argument, NULL, 'i'},
+        {"queue-limit", required_argument, NULL, 'q'},
+        {"accounting", no_argument, NULL, 'a'},
+        {"cgroup", required_argument, NULL, 'g'},
+        {"cpu-max", required_argument, NULL, 'p'},
+        {"memory-max", required_argument, NULL, 'b'},
+        {"perf", required_argument, NULL, 'k'},
+        {"perf-players", no_argument, NULL, 'x'},
+        {"stats", required_argument, NULL, 'z'},
+        {NULL, 0, NULL, 0}
+    };
+    int flag;
+
+    // Stop at the seed, and report bad flags as usage errors ourselves.
+    opterr = 0;
+    while ((flag = getopt_long(argc, argv,
+            "+smuaxf:e:t:y:w:r:l:n:d:j:c:v:o:i:q:g:p:b:k:z:", longOptions,
+            NULL)) != -1) {
+        switch (flag) {
+            case 's':
+                options.simultaneous = true;
+                break;
+            case 'm':
+                options.masks = true;
+                break;
+            case 'u':
+                options.deltas = true;
+                break;
+            case 'a':
+                options.accounting = true;
+                break;
+            case 'x':
+                options.perfPlayers = true;
+                break;
+            case 'k':
+                if (!perf_open(optarg)) {
+                    handle_exit(INVALID_ARG);
+                }
+                break;
+            case 'z':
+                if ((statsFile = fopen(optarg, "w")) == NULL) {
+                    handle_exit(INVALID_ARG);
+                }
+                options.stats = optarg;
+                break;
+            case 'g':
+                options.cgroup = optarg;
+                break;
+            case 'p':
+                if (!arg_is_number(optarg)
+                        || (options.cpuMax = atoi(optarg)) < 1) {
+                    handle_exit(INVALID_ARG);
+                }
+                break;
+            case 'b':
+                if (!arg_is_number(optarg)
+                        || (options.memoryMax = atoll(optarg)) < 1) {
+                    handle_exit(INVALID_ARG);
+                }
+                break;
+            case 'f':
+                if ((options.format = format_from_name(optarg)) == -1) {
+                    handle_exit(INVALID_ARG);
+                }
+                break;
+            case 'e':
+                if (!arg_is_number(optarg)
+                        || (options.every = atoi(optarg)) < 1) {
+                    handle_exit(INVALID_ARG);
+                }
+                break;
+            case 'y':
+                if (!arg_is_number(optarg)
+                        || (options.sync = atoi(optarg)) < 1) {
+                    handle_exit(INVALID_ARG);
+                }
+                break;
+            case 'w':
+                options.snapshot = optarg;
+                break;
+            case 'r':
+                options.resume = optarg;
+                break;
+            case 'l':
+                options.listen = optarg;
+                break;
+            case 'd':
+                options.daemon = optarg;
+                break;
+            case 'c':
+                options.cache = optarg;
+                break;
+            case 'i':
+                options.scenario = optarg;
+                break;
+            case 'v':
+                if (!arg_is_number(optarg)
+                        || (options.levels = atoi(optarg)) < 1
+                        || options.levels > MAX_LEVELS) {
+                    handle_exit(INVALID_ARG);
+                }
+                break;
+            case 'o':
+                if (!arg_is_number(optarg)
+                        || (options.rounds = atoi(optarg)) < 1
+                        || options.rounds > MAX_ROUNDS) {
+                    handle_exit(INVALID_ARG);
+                }
+                break;
+            case 'q':
+                if (!arg_is_number(optarg)
+                        || (options.queueLimit = atoi(optarg)) < 1) {
+                    handle_exit(INVALID_ARG);
+                }
+                break;
+            case 'j':
+                if (!arg_is_number(optarg)
+                        || (options.jobs = atoi(optarg)) < 1) {
+                    handle_exit(INVALID_ARG);
+                }
+                break;
+            case 'n':
+                if (!arg_is_number(optarg)
+                        || (options.games = atoi(optarg)) < 1) {
+                    handle_exit(INVALID_ARG);
+                }
+                break;
+            case 't':
+                if (!trace_open(optarg)) {
+                    handle_exit(INVALID_ARG);
+                }
+                break;
+            default:
+                handle_exit(WRONG_ARGS);
+        }
+    }
+    // Games played at once have players of their own, but share a trace,
+    // counts, a snapshot file and cgroup names, which follow one game
+    if (options.games > 1 && options.listen == NULL
+            && (tracing() || perf_counting() || options.snapshot != NULL
+            || options.resume != NULL || options.cache != NULL
+            || options.cgroup != NULL)) {
+        handle_exit(INVALID_ARG);
+    }
+    // Only games played from their seed by programs we can read are
+    // cached, and cached games aren't played to be counted
+    if (options.cache != NULL && (options.listen != NULL
+            || options.resume != NULL || options.stats != NULL)) {
+        handle_exit(INVALID_ARG);
+    }
+    // Only players we start can be put in cgroups, and limits need one
+    if ((options.cgroup != NULL && options.listen != NULL)
+            || ((options.cpuMax > 0 || options.memoryMax > 0)
+            && options.cgroup == NULL)) {
+        handle_exit(INVALID_ARG);
+    }
+    // Players are counted along with the hub
+    if (options.perfPlayers && !perf_counting()) {
+        handle_exit(INVALID_ARG);
+    }
+    // A resumed game was already set up
+    if (options.scenario != NULL && options.resume != NULL) {
+        handle_exit(INVALID_ARG);
+    }
+    return optind - 1;
+}
+
+/*
+ * Adds an entry to a state message for all players, sending the message
+ * first if the entry would not fit.
+ *
+ * @param *game     the hub's game state.
+ * @param frame     state message being built, of EXT_MSG_MAX_LEN.
+ * @param entry     the entry to add.
+ */
+void add_state_entry(Game *game, char frame[], char entry[]) {
+    // Leave room for message name, separator, newline and terminator
+    if (strlen(frame) + strlen(entry) + strlen(STATE) + 3
+            > EXT_MSG_MAX_LEN) {
+        send_state_frame(game, frame);
+    }
+    if (frame[0] == '\0') {
+        sprintf(frame, "%d", game->round);
+    }
+    sprintf(frame + strlen(frame), "%c%s", STATE_SEPARATOR, entry);
+}
+
+/*
+ * Writes a state message to all players and empties it, without flushing.
+ *
+ * @param *game     the hub's game state.
+ * @param frame     state message being built, of EXT_MSG_MAX_LEN.
+ */
+void send_state_frame(Game *game, char frame[]) {
+    if (frame[0] == '\0') {
+        // Nothing changed, the round alone is still news.
+        sprintf(frame, "%d", game->round);
+    }
+    buffer_all(game, STATE, frame);
+    frame[0] = '\0';
+}
+
+/*
+ * Sends players a state message listing every player and train spot that
+ * differs from what they last saw, then notes they have seen it.
+ *
+ * @param *game     the hub's game state.
+ * @param *seen     the game as players last saw it.
+ */
+void send_changes(Game *game, Game *seen) {
+    char frame[EXT_MSG_MAX_LEN] = {'\0'}, entry[STATE_ENTRY_LEN];
+    Player *player, *before;
+
+    for (int i = 0; i < game->numPlayers; i++) {
+        player = game->players[i];
+        before = seen->players[i];
+        if (player->pos.x != before->pos.x || player->pos.y != before->pos.y
+                || player->loot != before->loot
+                || player->hits != before->hits
+                || memcmp(player->orders, before->orders, 2) != 0) {
+            player_state_entry(game, i, entry);
+            add_state_entry(game, frame, entry);
+        }
+    }
+    for (int i = 0; i < train_size(game); i++) {
+        if (game->train[i] != seen->train[i]) {
+            cell_state_entry(game, i, entry);
+            add_state_entry(game, frame, entry);
+        }
+    }
+    send_state_frame(game, frame);
+    flush_all(game);
+    copy_view(seen, game);
+}
+
+/*
+ * Copies the players and train of a game into another of the same size.
+ *
+ * @param *to       the game to update.
+ * @param *from     the game to copy.
+ */
+void copy_view(Game *to, Game *from) {
+    for (int i = 0; i < from->numPlayers; i++) {
+        to->players[i]->pos = from->players[i]->pos;
+        to->players[i]->loot = from->players[i]->loot;
+        to->players[i]->hits = from->players[i]->hits;
+        memcpy(to->players[i]->orders, from->players[i]->orders, 2);
+    }
+    memcpy(to->train, from->train, sizeof(int) * train_size(from));
+    index_loot(to);
+}
+
+/*
+ * Tells players the state of a resumed game or scenario, listing every
+ * player and train spot that differs from the start of a fresh game.
+ *
+ * @param *game     the hub's game state, restored from a snapshot or set
+ *                  up from a scenario.
+ */
+void resume_players(Game *game) {
+    Game *fresh = make_game(game->numPlayers, game->numCarriages,
+            game->numLevels, game->numRounds, game->seed);
+
+    send_changes(game, fresh);
+    free_game(fresh);
+}
+
+/*
+ * Initialises game, after checking arguments are correct.
+ *
+ * @param argc      count of arguments provided
+ * @param argv      array of pointers to arguments provided
+ * @return Game struct with game info and players.
+ */
+Game *init_args(int argc, char **argv) {
+    int numPlayers, numCarriages, width;
+    unsigned int seed;
+
+    // Check we an acceptable number of arguments. Players that connect
+    // are only counted.
+    if ((options.listen == NULL && argc < (3 + MIN_PLAYERS))
+            || (options.listen != NULL && argc != 4)) {
+        handle_exit(WRONG_ARGS);
+    }
+    // Check that seed and carriage arguments are numbers.
+    if (!arg_is_number(argv[1]) || !arg_is_number(argv[2])
+            || (options.listen != NULL && !arg_is_number(argv[3]))) {
+        handle_exit(INVALID_ARG);
+    }
+
+    // Extract number arguments for game.
+    char *temp;
+    numPlayers = options.listen == NULL ? argc - 3 : atoi(argv[3]);
+    seed = strtoul(argv[1], &temp, 10);
+    numCarriages = strtol(argv[2], &temp, 10);
+    // Final check for arguments
+    if (numPlayers < MIN_PLAYERS || numPlayers > MAX_PLAYERS ||
+            numCarriages < MIN_CARRIAGES) {
+        handle_exit(INVALID_ARG);
+    }
+    // A scenario sets the shape of the train, which the width must match
+    if (options.scenario != NULL && (!scenario_shape(options.scenario,
+            &width, &options.levels, &options.rounds)
+            || width != numCarriages)) {
+        handle_exit(INVALID_ARG);
+    }
+
+    // Initialise game struct
+    Game *game = make_game(numPlayers, numCarriages, options.levels,
+            options.rounds, seed);
+
+    return game;
+}
+
+/*
+ * ===========================================================================
+ * Hub daemon functions. The daemon stays up and runs each game job sent
+ * to its socket in a forked worker, so jobs skip starting the hub.
+ * ===========================================================================
+ */
+/*
+ * Accepts game jobs on the daemon socket, running at most options.jobs
+ * at once. Further jobs wait in the socket's queue. Never returns.
+ */
+void run_daemon(void) {
+    int server, client, running = 0;
+    // Jobs run programs as us, so only we may connect
+    mode_t mask = umask(S_IRWXG | S_IRWXO | S_IXUSR);
+    pid_t worker;
+
+    server = listen_socket(options.daemon);
+    umask(mask);
+    if (server == -1) {
+        handle_exit(PROCESS_FAIL);
+    }
+    while (1) {
+        // Collect finished workers, waiting for one if all are busy.
+        while (running > 0 && waitpid(-1, NULL,
+                running < options.jobs ? WNOHANG : 0) > 0) {
+            running--;
+        }
+        if ((client = accept(server, NULL, NULL)) == -1) {
+            continue;
+        }
+        if (!same_user(client)) {
+            close(client);
+            continue;
+        }
+        if ((worker = fork()) == 0) {
+            // The job starts its own trace and counts if it asks for them
+            close(server);
+            trace_close();
+            perf_close();
+            run_job(client);
+        }
+        if (worker > 0) {
+            running++;
+        }
+        close(client);
+    }
+}
+
+/*
+ * Checks that a client of the daemon is run by the same user as us.
+ *
+ * @param client    socket connected to the client.
+ * @return true if the same user, false if not or it can't be told.
+ */
+bool same_user(int client) {
+    struct ucred peer;
+    socklen_t length = sizeof(peer);
+
+    return getsockopt(client, SOL_SOCKET, SO_PEERCRED, &peer, &length) == 0
+            && peer.uid == getuid();
+}
+
+/*
+ * Runs one job for a client in a worker. The job is a line of the usual
+ * hub arguments, flags included. Game output and errors go back to the
+ * client, followed by the exit status of the game.
+ *
+ * @param client    socket connected to the client.
+ */
+void run_job(int client) {
+    char line[EXT_MSG_MAX_LEN], *args[JOB_MAX_ARGS + 1];
+    FILE *from = fdopen(dup(client), "r"), *to = fdopen(client, "w");
+    int numArgs, status;
+    pid_t game;
+
+    if (from == NULL || to == NULL || fgets(line, EXT_MSG_MAX_LEN, from)
+            == NULL) {
+        exit(PROCESS_FAIL);
+    }
+    numArgs = split_job(line, args);
+
+    // The game runs as it would from the command line
+    if ((game = fork()) == 0) {
+        if (dup2(client, STDOUT_FILENO) == -1
+                || dup2(client, STDERR_FILENO) == -1) {
+            exit(PROCESS_FAIL);
+        }
+        options = (Options) DEFAULT_OPTIONS;
+        optind = 0;
+        int flags = parse_options(numArgs, args);
+        if (options.daemon != NULL) {
+            handle_exit(INVALID_ARG);
+        }
+        play_games(numArgs - flags, args + flags);
+    }
+    if (game == -1 || waitpid(game, &status, 0) == -1) {
+        exit(PROCESS_FAIL);
+    }
+
+    // Report how the game ended, as a shell would
+    fprintf(to, "%s%d\n", JOB_EXIT, WIFEXITED(status) ? WEXITSTATUS(status)
+            : 128 + WTERMSIG(status));
+    fclose(to);
+    exit(EXIT_SUCCESS);
+}
+
+/*
+ * Splits a job line into arguments, as a shell would without quoting.
+ * The program name is filled in first.
+ *
+ * @param line      the job, which is split in place.
+ * @param args      array of JOB_MAX_ARGS + 1 to store the arguments in,
+ *                  ending with NULL.
+ * @return the number of arguments.
+ */
+int split_job(char line[], char *args[]) {
+    int numArgs = 0;
+    char *arg;
+
+    args[numArgs++] = "2310express";
+    for (arg = strtok(line, " \t\n"); arg != NULL && numArgs < JOB_MAX_ARGS;
+            arg = strtok(NULL, " \t\n")) {
+        args[numArgs++] = arg;
+    }
+    args[numArgs] = NULL;
+    return numArgs;
+}
+
+/*
+ * Finds the cache key of a game: its seed, train, players and the options
+ * that change what it prints, with the contents of the hub, each player
+ * program and any scenario. Keying on these alone relies on every player
+ * being deterministic, as the solver's node budget keeps it.
+ *
+ * @param *game         the game about to be played.
+ * @param playerPaths   paths of the player programs.
+ * @param *key          where to store the key.
+ * @return true if every program could be read, false otherwise.
+ */
+bool game_key(Game *game, char *playerPaths[], uint64_t *key) {
+    uint32_t parameters[] = {CACHE_VERSION, game->seed, game->numCarriages,
+            game->numLevels, game->numRounds, game->numPlayers,
+            options.format, options.every, options.simultaneous,
+            options.masks, options.deltas};
+    uint64_t hash = hash_bytes(CACHE_HASH_START, parameters,
+            sizeof(parameters));
+
+    // A changed hub may play the same game differently
+    if (!hash_program(hash, "/proc/self/exe", &hash)) {
+        return false;
+    }
+    for (int i = 0; i < game->numPlayers; i++) {
+        if (!hash_program(hash, playerPaths[i], &hash)) {
+            return false;
+        }
+    }
+    if (options.scenario != NULL
+            && !hash_file(hash, options.scenario, &hash)) {
+        return false;
+    }
+    *key = hash;
+    return true;
+}
+
+/*
+ * Sets up players and plays the games asked for, then exits.
+ *
+ * @param argc      count of arguments, after any flags
+ * @param argv      arguments, with argv[1] the seed
+ */
+void play_games(int argc, char **argv) {
+    Game *game = init_args(argc, argv);
+    Task *task;
+    uint64_t key;
+    if ((options.resume != NULL && !load_snapshot(game, options.resume))
+            || (options.scenario != NULL
+            && !load_scenario(game, options.scenario))) {
+        handle_exit(INVALID_ARG);
+    }
+
+    // Extract player paths, connected players have none
+    char *playerPaths[game->numPlayers];
+    for (int i = 3; i < argc && options.listen == NULL; i++) {
+        playerPaths[i - 3] = argv[i];
+    }
+    if (options.listen == NULL && options.games > 1) {
+        play_at_once(game, playerPaths);
+    }
+
+    task = make_task(game, stdout);
+    if (options.listen != NULL) {
+        // Players come to us
+        accept_players(task);
+    } else {
+        // Games played before are printed as they were, without players
+        if (options.cache != NULL && game_key(game, playerPaths, &key)) {
+            if (cache_replay(options.cache, key, stdout)) {
+                handle_exit(EXIT_SUCCESS);
+            }
+            record = open_memstream(&recorded, &recordedLength);
+        }
+
+        // Setup players
+        for (int i = 0; i < game->numPlayers; i++) {
+            setup_process(task, i, playerPaths);
+        }
+    }
+    if (!players_ready(game)) {
+        handle_exit(PROCESS_FAIL);
+    }
+
+    // Play games, connected players stay on for the next one.
+    for (int i = 0; i < options.games; i++) {
+        if (i > 0) {
+            next_game(task);
+        }
+        if (i > 0 && options.scenario != NULL
+                && !load_scenario(task->game, options.scenario)) {
+            handle_exit(INVALID_ARG);
+        }
+        if (options.listen != NULL) {
+            start_connected_game(task->game);
+        }
+        if ((i == 0 && options.resume != NULL) || options.scenario != NULL) {
+            resume_players(task->game);
+        }
+        start_task(task);
+        run_tasks(&task, 1);
+        if (task->status != EXIT_SUCCESS) {
+            handle_exit(task->status);
+        }
+        if (statsFile != NULL) {
+            write_stats(statsFile, &task->stats, options.format);
+            add_stats(&totalStats, &task->stats);
+            fflush(statsFile);
+        }
+    }
+    // Games played one after another are summed at the end
+    if (statsFile != NULL && options.games > 1) {
+        write_stats(statsFile, &totalStats, options.format);
+        fflush(statsFile);
+    }
+    if (record != NULL && (fclose(record) == EOF
+            || !cache_store(options.cache, key, recorded, recordedLength))) {
+        fprintf(stderr, "Unable to store game in cache\n");
+    }
+    handle_exit(EXIT_SUCCESS);
+}
+
+/*
+ * Plays options.games games at once, each with players of its own and
+ * the next seed, then exits. What each game prints is held back until
+ * every game is over, then printed in seed order, with why any game
+ * failed. The hub exits with the status of the first game that failed.
+ *
+ * @param *first        the first game, with the seed given.
+ * @param playerPaths   paths of the player programs.
+ */
+void play_at_once(Game *first, char *playerPaths[]) {
+    Task *tasks[options.games];
+    char *printed[options.games];
+    size_t printedLength[options.games];
+    int status = EXIT_SUCCESS;
+    Game *game;
+
+    // Every game's players are started before any is waited on
+    for (int i = 0; i < options.games; i++) {
+        game = first;
+        if (i > 0) {
+            game = make_game(first->numPlayers, first->numCarriages,
+                    first->numLevels, first->numRounds, first->seed + i);
+        }
+        if (i > 0 && options.scenario != NULL
+                && !load_scenario(game, options.scenario)) {
+            handle_exit(INVALID_ARG);
+        }
+        tasks[i] = make_task(game, open_memstream(&printed[i],
+                &printedLength[i]));
+        for (int j = 0; j < game->numPlayers; j++) {
+            setup_process(tasks[i], j, playerPaths);
+        }
+    }
+    for (int i = 0; i < options.games; i++) {
+        if (!players_ready(tasks[i]->game)) {
+            handle_exit(PROCESS_FAIL);
+        }
+        if (options.scenario != NULL) {
+            resume_players(tasks[i]->game);
+        }
+        start_task(tasks[i]);
+    }
+    run_tasks(tasks, options.games);
+
+    for (int i = 0; i < options.games; i++) {
+        fclose(tasks[i]->out);
+        fwrite(printed[i], 1, printedLength[i], stdout);
+        fflush(stdout);
+        free(printed[i]);
+        if (tasks[i]->status != EXIT_SUCCESS) {
+            exit_message(tasks[i]->status);
+            status = status == EXIT_SUCCESS ? tasks[i]->status : status;
+        } else if (statsFile != NULL) {
+            write_stats(statsFile, &tasks[i]->stats, options.format);
+            add_stats(&totalStats, &tasks[i]->stats);
+        }
+    }
+    // Games that finished are summed at the end
+    if (statsFile != NULL) {
+        write_stats(statsFile, &totalStats, options.format);
+        fflush(statsFile);
+    }
+    exit_hub(status);
+}
+
+int main(int argc, char **argv) {
+    // Main signal handler
+    struct sigaction sa;
+    sa.sa_handler = &handle_sig;
+    sa.sa_flags = SA_RESTART;
+    // Handle SIGINT
+    sigaction(SIGINT, &sa, NULL);
+
+    // Ignore these signals
+    struct sigaction saIgnore;
+    saIgnore.sa_handler = SIG_IGN;
+    saIgnore.sa_flags = SA_RESTART;
+    sigaction(SIGPIPE, &saIgnore, NULL);
+
+    // Round summaries leave in one write at the end of each round
+    setvbuf(stdout, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+
+    // Drop flags so positional arguments keep their usual places.
+    int flags = parse_options(argc, argv);
+    if (options.daemon != NULL) {
+        run_daemon();
     }
-    // Play game
-    hub_game_loop(game);
+    play_games(argc - flags, argv + flags);
 
     return EXIT_SUCCESS;
 }
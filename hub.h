@@ -3,8 +3,12 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
 #include "shared.h"
+#include "comms.h"
+#include "stats.h"
+#include "accounting.h"
 
 /*
  * ===========================================================================
@@ -20,12 +24,153 @@
 #define PLAYER_CLOSED 4
 #define PROTOCOL_ERROR 5
 #define ILLEGAL_MOVE 6
+#define DESYNC 7
 #define GOT_SIGINT 9
 
+/* Longest game job the daemon takes, in arguments, and its reply */
+#define JOB_MAX_ARGS 64
+#define JOB_EXIT "exit"
+
+/* Most bytes waiting to leave for a player before it counts as gone, the
+ * first room made for them, and how long a queue is given at exit */
+#define DEFAULT_QUEUE_LIMIT (64 << 20)
+#define QUEUE_START_SIZE 4096
+#define QUEUE_DRAIN_MS 2000
+
 /* Pipe ends */
 #define READ 0
 #define WRITE 1
 
+/* Steps of a round, see run_step */
+#define STEP_ROUND 0
+#define STEP_ORDERS 1
+#define STEP_ANNOUNCE 2
+#define STEP_EXECUTE 3
+#define STEP_RUN_ORDERS 4
+#define STEP_SYNC 5
+#define STEP_CHECK_SYNC 6
+#define STEP_REPORT 7
+#define STEP_DONE 8
+
+/* Typedef Structs for readability */
+typedef struct HubOptions Options;
+typedef struct HubLine Line;
+typedef struct HubTask Task;
+typedef struct HubQueue Queue;
+
+/* Optional hub modes, set by flags given before the seed */
+struct HubOptions {
+    // Request all orders at once instead of one player at a time.
+    bool simultaneous;
+    // Send players their legal actions with 'yourturn'.
+    bool masks;
+    // Send players a state message of what changed each round instead of
+    // each action run.
+    bool deltas;
+    // Output format for round summaries and winners.
+    int format;
+    // Report the state every this many rounds.
+    int every;
+    // Compare game hashes with players every this many rounds, 0 if never.
+    int sync;
+    // File to save a snapshot to after each round, if any.
+    char *snapshot;
+    // Snapshot to resume the game from, if any.
+    char *resume;
+    // Socket players connect to, if they aren't started by the hub.
+    char *listen;
+    // Games to play, one after another with connected players, otherwise
+    // all at once with players of their own.
+    int games;
+    // Socket to take game jobs on as a daemon, if any.
+    char *daemon;
+    // Most game jobs the daemon runs at once.
+    int jobs;
+    // Directory of stored game output to check before playing, if any.
+    char *cache;
+    // Levels of the train and rounds in each game.
+    int levels;
+    int rounds;
+    // Scenario to set up each game from instead of the seed, if any.
+    char *scenario;
+    // Most bytes queued for a player before it counts as disconnected.
+    int queueLimit;
+    // Print what each player cost at exit.
+    bool accounting;
+    // cgroup v2 directory to give each player a leaf in, if any, and the
+    // leaves' limits, 0 if none.
+    char *cgroup;
+    int cpuMax;
+    long long memoryMax;
+    // Count the players we start as well as the hub with --perf.
+    bool perfPlayers;
+    // File to write what each player did in each game to, if any.
+    char *stats;
+};
+
+/* Options before any flags are read */
+#define DEFAULT_OPTIONS {.format = FORMAT_TEXT, .every = 1, .games = 1, \
+        .jobs = 4, .levels = DEFAULT_LEVELS, .rounds = DEFAULT_ROUNDS, \
+        .queueLimit = DEFAULT_QUEUE_LIMIT}
+
+/* What has been read from a player but not yet taken as a message */
+struct HubLine {
+    char text[EXT_MSG_MAX_LEN];
+    int length;
+};
+
+/*
+ * Messages written to a player that haven't left yet. Writes never wait
+ * on the player, what its pipe can't take is sent by the event loop.
+ */
+struct HubQueue {
+    // Player's end of the pipe or socket, set not to block.
+    int fd;
+    // Queued bytes, those from sent up to length are still to leave.
+    char *data;
+    size_t sent;
+    size_t length;
+    size_t capacity;
+    // Set once the player stops reading or its queue passes the limit.
+    bool closed;
+};
+
+/*
+ * A game run by the hub. A task runs until it needs a reply from a player,
+ * then picks up where it left off once the event loop has read one.
+ */
+struct HubTask {
+    Game *game;
+    // EXIT_SUCCESS, or the exit code of the first way a player broke the
+    // game, which ends the task.
+    int status;
+    // Where round summaries and winners are printed.
+    FILE *out;
+    // Messages waiting to leave for each player, NULL until seated.
+    Queue **outbound;
+    // What each player we started has cost.
+    Cost *costs;
+    // What players did this game.
+    Stats stats;
+    // Step of the round the game is up to, one of the STEP_ constants.
+    int step;
+    // Next player to order or execute in this step.
+    int next;
+    // Players whose reply the step is waiting on, and how many.
+    bool *waiting;
+    int numWaiting;
+    // Players whose hash didn't match in the last sync.
+    bool *outOfSync;
+    // Unfinished messages from each player.
+    Line *lines;
+    // Trace spans open while waiting on each player, the round and step.
+    int *spans;
+    int roundSpan;
+    int stepSpan;
+    // The game as players last saw it, if options.deltas is set.
+    Game *seen;
+};
+
 /*
  * ===========================================================================
  * Hub handler functions
@@ -41,10 +186,25 @@ void exit_clean_up(int exitStatus);
 /*
  * Checks if player exited cleanly.
  *
+ * @param *task     the task the player belongs to.
  * @param player    the id of the player.
  * @return true if player exited, false otherwise.
  */
-bool player_exit(int player);
+bool player_exit(Task *task, int player);
+
+/*
+ * Prints why the hub or a game is ending.
+ *
+ * @param exitStatus    the exit code.
+ */
+void exit_message(int exitStatus);
+
+/*
+ * Shuts players down if the exit status calls for it, then exits.
+ *
+ * @param exitStatus    the exit code.
+ */
+void exit_hub(int exitStatus);
 
 /*
  * Handler for signals. Only handles sig int for this program.
@@ -65,10 +225,10 @@ void handle_sig(int sig);
  * @param input         input to player pipe
  * @param output        output from player pipe
  * @param *playerPath   path for player file.
- * @param *game         game struct with game data
+ * @param *task         task whose game the player is in
  * @param id            the id of this player
  */
-void setup_child_fork(int input[], int output[], char *playerPath, Game *game,
+void setup_child_fork(int input[], int output[], char *playerPath, Task *task,
         int id);
 
 /*
@@ -76,21 +236,44 @@ void setup_child_fork(int input[], int output[], char *playerPath, Game *game,
  *
  * @param input    input to player pipe
  * @param output   output from player pipe
- * @param *game    game structure and data
+ * @param *task    task whose game the player is in
  * @param id       player ID per position in player array
  * @param pid      player process PID
  */
-void setup_parent_fork(int input[], int output[], Game *game, int pos,
+void setup_parent_fork(int input[], int output[], Task *task, int id,
         pid_t pid);
 
 /*
  * Setup pipes for players and execs player process.
  *
- * @param *game         struct representing the Game.
+ * @param *task         task whose game the player is in.
  * @param id            id of player in array of players.
  * @param *playerPaths  array of player paths for exec
  */
-void setup_process(Game *game, int id, char *playerPaths[]);
+void setup_process(Task *task, int id, char *playerPaths[]);
+
+/*
+ * Waits for players to connect to the listening socket, seating them in
+ * the order they connect. Connected players have no pid.
+ *
+ * @param *task     the task whose game they play.
+ */
+void accept_players(Task *task);
+
+/*
+ * Tells connected players a game is starting and which seat they have.
+ *
+ * @param *game     the game about to start.
+ */
+void start_connected_game(Game *game);
+
+/*
+ * Moves a task on to the next game for the same connected players, with
+ * the next seed.
+ *
+ * @param *task     the task, whose game just played is freed.
+ */
+void next_game(Task *task);
 
 /*
  * Checks that all players are ready.
@@ -101,6 +284,91 @@ void setup_process(Game *game, int id, char *playerPaths[]);
  */
 bool players_ready(Game *game);
 
+/*
+ * Reads optional flags that precede the seed into the hub options.
+ *
+ * @param argc      count of arguments provided
+ * @param argv      array of pointers to arguments provided
+ * @return number of arguments consumed by flags.
+ */
+int parse_options(int argc, char **argv);
+
+/*
+ * Adds an entry to a state message for all players, sending the message
+ * first if the entry would not fit.
+ *
+ * @param *game     the hub's game state.
+ * @param frame     state message being built, of EXT_MSG_MAX_LEN.
+ * @param entry     the entry to add.
+ */
+void add_state_entry(Game *game, char frame[], char entry[]);
+
+/*
+ * Writes a state message to all players and empties it, without flushing.
+ *
+ * @param *game     the hub's game state.
+ * @param frame     state message being built, of EXT_MSG_MAX_LEN.
+ */
+void send_state_frame(Game *game, char frame[]);
+
+/*
+ * Sends players a state message listing every player and train spot that
+ * differs from what they last saw, then notes they have seen it.
+ *
+ * @param *game     the hub's game state.
+ * @param *seen     the game as players last saw it.
+ */
+void send_changes(Game *game, Game *seen);
+
+/*
+ * Copies the players and train of a game into another of the same size.
+ *
+ * @param *to       the game to update.
+ * @param *from     the game to copy.
+ */
+void copy_view(Game *to, Game *from);
+
+/*
+ * Tells players the state of a resumed game or scenario, listing every
+ * player and train spot that differs from the start of a fresh game.
+ *
+ * @param *game     the hub's game state, restored from a snapshot or set
+ *                  up from a scenario.
+ */
+void resume_players(Game *game);
+
+/*
+ * Finds the cache key of a game: its seed, train, players and the options
+ * that change what it prints, with the contents of the hub, each player
+ * program and any scenario. Keying on these alone relies on every player
+ * being deterministic, as the solver's node budget keeps it.
+ *
+ * @param *game         the game about to be played.
+ * @param playerPaths   paths of the player programs.
+ * @param *key          where to store the key.
+ * @return true if every program could be read, false otherwise.
+ */
+bool game_key(Game *game, char *playerPaths[], uint64_t *key);
+
+/*
+ * Sets up players and plays the games asked for, then exits.
+ *
+ * @param argc      count of arguments, after any flags
+ * @param argv      arguments, with argv[1] the seed
+ */
+void play_games(int argc, char **argv);
+
+/*
+ * Plays options.games games at once, each with players of its own and
+ * the next seed, then exits. What each game prints is held back until
+ * every game is over, then printed in seed order, with why any game
+ * failed. The hub exits with the status of the first game that failed.
+ *
+ * @param *first        the first game, with the seed given.
+ * @param playerPaths   paths of the player programs.
+ */
+void play_at_once(Game *first, char *playerPaths[]);
+
 /*
  * Initialises game, after checking arguments are correct.
  *
@@ -115,6 +383,16 @@ Game *init_args(int argc, char **argv);
  * Hub game functions
  * ===========================================================================
  */
+/*
+ * Tells players an action was run, unless options.deltas is set. Players
+ * then learn what it did from the next state message instead.
+ *
+ * @param *game     current game state.
+ * @param message   the action message.
+ * @param params    the player and any target or direction.
+ */
+void tell_players(Game *game, char *message, char *params);
+
 /*
  * Handles dry out instruction, sends execution phase message when done.
  *
@@ -127,18 +405,20 @@ void handle_dryout(Game *game, int id);
  * Handles looting instructions. Sends execution phase message when done.
  *
  * @param *game     current game state.
+ * @param *stats    the game's counts.
  * @param id        player id we are handling.
  */
-void handle_loot(Game *game, int id);
+void handle_loot(Game *game, Stats *stats, int id);
 
 /*
  * Handles shooting instructions. Sends execution phase instructions once
  * finalised.
  *
  * @param *game     the current game state.
+ * @param *stats    the game's counts.
  * @param id        player id we are handling
  */
-void handle_shot(Game *game, int id);
+void handle_shot(Game *game, Stats *stats, int id);
 
 /*
  * Handles movement instructions. Sends execution phase instructions once
@@ -150,49 +430,423 @@ void handle_shot(Game *game, int id);
 void handle_movement(Game *game, int id);
 
 /*
- * Gathers/seeks further instructions.
+ * Asks a player for the direction or target of its order.
  *
  * @param *game     the hub's game state.
  * @param id        the player we are requesting additional info from.
  */
-void gather_instructions(Game *game, int id);
+void request_instructions(Game *game, int id);
+
+/*
+ * Records the direction or target a player replied with.
+ *
+ * @param *game         the hub's game state.
+ * @param id            the player that replied.
+ * @param instruction   the player's reply.
+ * @return true if recorded, false if the reply breaks the protocol.
+ */
+bool receive_instructions(Game *game, int id, char instruction[]);
+
+/*
+ * Resolves the direction of a compound horizontal move. Directions that
+ * would leave the train turn around instead.
+ *
+ * @param *game     the hub's game state.
+ * @param id        the player whose move we are resolving.
+ */
+void resolve_direction(Game *game, int id);
+
+/*
+ * Resolves the target of a compound shot against the current state.
+ * Falls back to no target if no player can be shot.
+ *
+ * @param *game     the hub's game state.
+ * @param id        the player whose shot we are resolving.
+ */
+void resolve_target(Game *game, int id);
+
+/*
+ * Checks every order of the round is a real order before any is run.
+ *
+ * @param *game     the hub's view of game state.
+ * @return true if every order is real, false otherwise.
+ */
+bool check_orders(Game *game);
 
 /*
- * Execution phase, hub examines orders and requests more information
- * if appropriate, before sending instructions to players + updating state.
+ * Fills in the direction or target of an order from the player's
+ * policy, if it gave one.
  *
  * @param *game     the hub's view of game state.
+ * @param id        the player whose order is next to run.
+ * @return true if the player must be asked for the rest, else false.
  */
-void execution_phase(Game *game);
+bool prepare_order(Game *game, int id);
 
 /*
- * Requests an order from the player, non execution phase.
- * Expects some kind of playX order, then sends order to players.
+ * Runs a complete order, updating state and telling players.
+ *
+ * @param *game     the hub's view of game state.
+ * @param *stats    the game's counts.
+ * @param id        the player whose order is run.
+ * @return true if run, false if the order is illegal.
+ */
+bool execute_order(Game *game, Stats *stats, int id);
+
+/*
+ * Records the order a player sent in response to 'yourturn'.
+ *
+ * @param *game     the current game state according to the hub.
+ * @param id        the player whose order we are receiving.
+ * @param message   the player's reply.
+ * @return true if recorded, false if the reply breaks the protocol.
+ */
+bool receive_order(Game *game, int id, char message[]);
+
+/*
+ * Stores a plan sent by a player, covering this round onwards.
+ *
+ * @param *game     the current game state according to the hub.
+ * @param id        the player who sent the plan.
+ * @param message   the plan message, already checked for format.
+ * @return true if stored, false if a rule breaks the protocol.
+ */
+bool receive_plan(Game *game, int id, char message[]);
+
+/*
+ * Checks whether a plan rule predicate holds for a player.
  *
  * @param *game     the current game state according to the hub.
+ * @param id        the player the plan belongs to.
+ * @param predicate the predicate of the rule.
+ * @return true if the predicate holds, else false.
  */
-void request_player_action(Game *game);
+bool rule_holds(Game *game, int id, char predicate);
 
 /*
- * Hub game loop to run game.
+ * Orders on behalf of a player using the first rule of its plan that
+ * holds. Plans that are spent or have no rule holding are dropped, so
+ * that the player is asked instead.
  *
- * @param *game     the game state and data
+ * @param *game     the current game state according to the hub.
+ * @param id        the player we are ordering for.
+ * @return true if the plan gave an order, else false.
  */
-void hub_game_loop(Game *game);
+bool follow_plan(Game *game, int id);
 
 /*
  * Reports the winners of the game.
  *
  * @param *game     game state according to hub.
+ * @param out       stream the game is printed to.
+ */
+void determine_winners(Game *game, FILE *out);
+
+/*
+ * Reports the game state after a round, if the round is sampled.
+ * The final round is always reported.
+ *
+ * @param *game     game state according to hub.
+ * @param out       stream the game is printed to.
+ */
+void report_round(Game *game, FILE *out);
+
+/*
+ * ===========================================================================
+ * Hub outbound queue functions
+ * ===========================================================================
+ */
+/*
+ * Makes the stream messages to a player are written to. Its writes are
+ * queued for the player instead of waiting for it to read them.
+ *
+ * @param fd        the player's end of its pipe or socket.
+ * @param **queue   where to store the player's queue.
+ * @return the stream, or NULL if it couldn't be made.
+ */
+FILE *open_queue(int fd, Queue **queue);
+
+/*
+ * Queues bytes flushed from a player's stream, sending what the player
+ * will take straight away. Passing the queue limit closes the queue.
+ *
+ * @param *cookie   the player's queue.
+ * @param buffer    the bytes flushed.
+ * @param size      how many bytes were flushed.
+ * @return size, bytes for closed queues are dropped.
+ */
+ssize_t queue_write(void *cookie, const char *buffer, size_t size);
+
+/*
+ * Closes a player's stream, dropping anything still queued.
+ *
+ * @param *cookie   the player's queue.
+ * @return 0 if closed, -1 otherwise.
+ */
+int queue_close(void *cookie);
+
+/*
+ * Sends as much of a queue as the player will take without waiting. The
+ * queue is closed if the player can no longer be written to.
+ *
+ * @param *queue    the queue to send.
+ */
+void send_queued(Queue *queue);
+
+/*
+ * Checks if a queue has bytes left to send.
+ *
+ * @param *queue    the queue, NULL if the player has none.
+ * @return true if bytes are waiting and the queue is open, else false.
+ */
+bool queue_pending(Queue *queue);
+
+/*
+ * Waits for the players of a task to take what is queued for them, giving
+ * each up to timeout milliseconds between writes.
+ *
+ * @param *task     the task whose queues are drained.
+ * @param timeout   milliseconds to wait for a player to take more.
+ */
+void drain_queues(Task *task, int timeout);
+
+/*
+ * ===========================================================================
+ * Hub task functions. Each game is a task that runs as much of a round as
+ * it can, then hands back to the event loop until its players reply.
+ * ===========================================================================
+ */
+/*
+ * Makes a task to run a game, before its players are seated. Tasks last
+ * until the hub exits, which shuts down every task's players.
+ *
+ * @param *game     the game to run.
+ * @param out       stream the game is printed to.
+ * @return the task, to be started once its players are ready.
+ */
+Task *make_task(Game *game, FILE *out);
+
+/*
+ * Readies a task to play its game from the next round, once its players
+ * are ready and have been told of any resumed state.
+ *
+ * @param *task     the task to start.
+ */
+void start_task(Task *task);
+
+/*
+ * Ends a task whose player broke the game, keeping the first reason for
+ * when the game is reported. Its players are shut down at exit.
+ *
+ * @param *task     the task to end.
+ * @param status    why, one of the player error exit codes.
+ */
+void fail_task(Task *task, int status);
+
+/*
+ * Notes that a task can't go on until a player replies.
+ *
+ * @param *task     the task waiting.
+ * @param id        the player the task is waiting on.
+ */
+void wait_for(Task *task, int id);
+
+/*
+ * Starts the next round, or ends the game once every round is played.
+ *
+ * @param *task     the task running the game.
+ */
+void start_round(Task *task);
+
+/*
+ * Tells all players the order a player made.
+ *
+ * @param *game     the current game state according to the hub.
+ * @param id        the player who made the order.
+ */
+void announce_order(Game *game, int id);
+
+/*
+ * Tells a player it is their turn to order, with their legal actions if
+ * options.masks is set.
+ *
+ * @param *game     the current game state according to the hub.
+ * @param id        the player to order.
+ */
+void send_turn(Game *game, int id);
+
+/*
+ * Requests orders from players one at a time, non execution phase.
+ * Each order is sent to all players before the next player is asked.
+ * Stops at the first player that has to be asked.
+ *
+ * @param *task     the task running the game.
+ */
+void request_player_action(Task *task);
+
+/*
+ * Requests orders from all players at once. Orders are broadcast
+ * together once all replies are in.
+ *
+ * @param *task     the task running the game.
+ */
+void request_simultaneous_action(Task *task);
+
+/*
+ * Sends all orders of a simultaneous round to players, in one write per
+ * player.
+ *
+ * @param *task     the task running the game.
+ */
+void announce_orders(Task *task);
+
+/*
+ * Starts the execution phase once every order is in.
+ *
+ * @param *task     the task running the game.
+ */
+void start_execution(Task *task);
+
+/*
+ * Execution phase, runs orders in player order, asking players for
+ * further instructions if their order needs them. Stops at the first
+ * player that has to be asked.
+ *
+ * @param *task     the task running the game.
+ */
+void execution_phase(Task *task);
+
+/*
+ * Asks every player for its game hash, if this round is checked.
+ *
+ * @param *task     the task running the game.
+ */
+void request_sync(Task *task);
+
+/*
+ * Compares a player's game hash with the hub's.
+ *
+ * @param *task     the task running the game.
+ * @param id        the player that replied.
+ * @param message   the player's reply.
+ */
+void receive_hash(Task *task, int id, char message[]);
+
+/*
+ * Checks every player's game hash matched the hub's, failing the task if
+ * not.
+ *
+ * @param *task     the task running the game.
+ */
+void check_sync(Task *task);
+
+/*
+ * Ends a round, printing the game summary and saving a snapshot.
+ *
+ * @param *task     the task running the game.
+ */
+void finish_round(Task *task);
+
+/*
+ * Runs the current step of a task, which has no replies outstanding.
+ *
+ * @param *task     the task to run.
+ */
+void run_step(Task *task);
+
+/*
+ * Hands a player's reply to the step that was waiting on it.
+ *
+ * @param *task     the task waiting on the player.
+ * @param id        the player that replied.
+ * @param message   the player's reply.
+ */
+void deliver_message(Task *task, int id, char message[]);
+
+/*
+ * Reads whatever a player has sent so far, failing the task if the player
+ * has closed.
+ *
+ * @param *task     the task the player belongs to.
+ * @param id        the player to read from.
+ */
+void read_player(Task *task, int id);
+
+/*
+ * Takes the first whole message read from a player, if there is one.
+ * Messages too long for the buffer are taken as they are.
+ *
+ * @param *task     the task the player belongs to.
+ * @param id        the player the message is from.
+ * @param message   buffer of EXT_MSG_MAX_LEN to store the message in.
+ * @return true if a message was taken, else false.
+ */
+bool take_message(Task *task, int id, char message[]);
+
+/*
+ * Runs a task until it is finished or waiting on a reply that hasn't
+ * been read yet.
+ *
+ * @param *task     the task to run.
+ */
+void advance_task(Task *task);
+
+/*
+ * Fails a task if one of its players has stopped taking messages.
+ *
+ * @param *task     the task to check.
+ */
+void check_queues(Task *task);
+
+/*
+ * Event loop, runs tasks on this thread until every game is over. Only
+ * players a task is waiting on are listened to, and only players with
+ * messages queued are written to.
+ *
+ * @param *tasks    the tasks to run.
+ * @param numTasks  the number of tasks.
+ */
+void run_tasks(Task *tasks[], int numTasks);
+
+/*
+ * ===========================================================================
+ * Hub daemon functions. The daemon stays up and runs each game job sent
+ * to its socket in a forked worker, so jobs skip starting the hub.
+ * ===========================================================================
+ */
+/*
+ * Accepts game jobs on the daemon socket, running at most options.jobs
+ * at once. Further jobs wait in the socket's queue. Never returns.
+ */
+void run_daemon(void);
+
+/*
+ * Checks that a client of the daemon is run by the same user as us.
+ *
+ * @param client    socket connected to the client.
+ * @return true if the same user, false if not or it can't be told.
+ */
+bool same_user(int client);
+
+/*
+ * Runs one job for a client in a worker. The job is a line of the usual
+ * hub arguments, flags included. Game output and errors go back to the
+ * client, followed by the exit status of the game.
+ *
+ * @param client    socket connected to the client.
  */
-void determine_winners(Game *game);
+void run_job(int client);
 
 /*
- * Prints the current game state teo terminal/stdout.
+ * Splits a job line into arguments, as a shell would without quoting.
+ * The program name is filled in first.
  *
- * @param *game     game data that state will be drawn from.
+ * @param line      the job, which is split in place.
+ * @param args      array of JOB_MAX_ARGS + 1 to store the arguments in,
+ *                  ending with NULL.
+ * @return the number of arguments.
  */
-void print_game_state(Game *game);
+int split_job(char line[], char *args[]);
 
 
 #endif
@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include "logging.h"
+
+/*
+ * ===========================================================================
+ * CSSE2310 Assignment 3
+ * LOGGING - Player event logging
+ * ===========================================================================
+ */
+
+// Where log lines go
+int logMode = LOG_TO_STDERR;
+// Recent log lines in ring mode, next write at ringHead.
+char logRing[LOG_RING_SIZE];
+int ringHead;
+// True once the ring has been written all the way round.
+bool ringFull;
+
+/*
+ * Chooses the runtime log mode from the environment.
+ * Unset or unknown modes log straight to stderr.
+ */
+void log_init(void) {
+    char *mode = getenv(LOG_ENV);
+
+    if (mode != NULL && strcmp(mode, "ring") == 0) {
+        logMode = LOG_TO_RING;
+    } else if (mode != NULL && strcmp(mode, "off") == 0) {
+        logMode = LOG_OFF;
+    } else {
+        logMode = LOG_TO_STDERR;
+    }
+}
+
+/*
+ * Logs a formatted line according to the runtime mode.
+ *
+ * @param format    printf style format of the line, without newline.
+ */
+void log_message(const char *format, ...) {
+    char line[LOG_LINE_MAX];
+    va_list args;
+    int length;
+
+    if (logMode == LOG_OFF) {
+        return;
+    }
+
+    va_start(args, format);
+    if (logMode == LOG_TO_STDERR) {
+        vfprintf(stderr, format, args);
+        fputc('\n', stderr);
+        va_end(args);
+        return;
+    }
+    length = vsnprintf(line, LOG_LINE_MAX - 1, format, args);
+    va_end(args);
+
+    // Keep the line in the ring, overwriting the oldest lines. Lines
+    // that can't be formatted are kept empty.
+    if (length < 0) {
+        length = 0;
+    } else if (length > LOG_LINE_MAX - 2) {
+        length = LOG_LINE_MAX - 2;
+    }
+    line[length++] = '\n';
+    for (int i = 0; i < length; i++) {
+        logRing[ringHead++] = line[i];
+        if (ringHead == LOG_RING_SIZE) {
+            ringHead = 0;
+            ringFull = true;
+        }
+    }
+}
+
+/*
+ * Writes out everything held in the ring, oldest first.
+ *
+ * @param to    stream to write the ring to.
+ */
+void log_dump(FILE *to) {
+    if (ringFull) {
+        fwrite(logRing + ringHead, 1, LOG_RING_SIZE - ringHead, to);
+    }
+    fwrite(logRing, 1, ringHead, to);
+    fflush(to);
+}
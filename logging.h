@@ -0,0 +1,70 @@
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#include <stdio.h>
+
+/*
+ * ===========================================================================
+ * Player event logging header file
+ * ===========================================================================
+ */
+
+/* Log levels, higher levels are chattier */
+#define LOG_NONE 0
+#define LOG_ERROR 1
+#define LOG_EVENT 2
+#define LOG_DEBUG 3
+
+/* Highest level compiled in, e.g. make LOG_LEVEL=0 removes all logging */
+#ifndef PLAYER_LOG_LEVEL
+#define PLAYER_LOG_LEVEL LOG_DEBUG
+#endif
+
+/* Runtime log modes, chosen by the PLAYER_LOG environment variable */
+#define LOG_ENV "PLAYER_LOG"
+#define LOG_TO_STDERR 0
+#define LOG_TO_RING 1
+#define LOG_OFF 2
+
+/* Bytes of recent log kept in ring mode */
+#define LOG_RING_SIZE 16384
+/* Longest single log line, longer lines are cut short */
+#define LOG_LINE_MAX 128
+
+/*
+ * Logs an event at a level. Levels above PLAYER_LOG_LEVEL compile to
+ * nothing, arguments are not evaluated.
+ */
+#define player_log(level, ...) \
+    do { \
+        if ((level) <= PLAYER_LOG_LEVEL) { \
+            log_message(__VA_ARGS__); \
+        } \
+    } while (0)
+
+/*
+ * ===========================================================================
+ * Logging functions
+ * ===========================================================================
+ */
+/*
+ * Chooses the runtime log mode from the environment.
+ * Unset or unknown modes log straight to stderr.
+ */
+void log_init(void);
+
+/*
+ * Logs a formatted line according to the runtime mode.
+ *
+ * @param format    printf style format of the line, without newline.
+ */
+void log_message(const char *format, ...);
+
+/*
+ * Writes out everything held in the ring, oldest first.
+ *
+ * @param to    stream to write the ring to.
+ */
+void log_dump(FILE *to);
+
+#endif
@@ -0,0 +1,218 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "output.h"
+
+/*
+ * ===========================================================================
+ * CSSE2310 Assignment 3
+ * OUTPUT - Game state reporting for the hub
+ * ===========================================================================
+ */
+
+/* Names of formats, indexed by format */
+char *formatNames[] = {"text", "json", "binary", "quiet"};
+
+/* Function prototypes local to output */
+void put_u16(FILE *to, uint16_t value);
+void print_text_state(Game *game, FILE *to);
+void print_json_state(Game *game, FILE *to);
+void print_binary_state(Game *game, FILE *to);
+
+/*
+ * ===========================================================================
+ * Binary helpers
+ * ===========================================================================
+ */
+/*
+ * Writes a 16 bit value in little endian order.
+ *
+ * @param to        stream to write to.
+ * @param value     the value to write.
+ */
+void put_u16(FILE *to, uint16_t value) {
+    fputc(value & 0xFF, to);
+    fputc(value >> 8, to);
+}
+
+/*
+ * Writes a 32 bit value in little endian order.
+ *
+ * @param to        stream to write to.
+ * @param value     the value to write.
+ */
+void put_u32(FILE *to, uint32_t value) {
+    put_u16(to, value & 0xFFFF);
+    put_u16(to, value >> 16);
+}
+
+/*
+ * Reads a 32 bit value in little endian order.
+ *
+ * @param from      stream to read from.
+ * @param *value    where to store the value.
+ * @return true if read, false at end of file.
+ */
+bool get_u32(FILE *from, uint32_t *value) {
+    unsigned char bytes[4];
+
+    if (fread(bytes, 1, 4, from) != 4) {
+        return false;
+    }
+    *value = bytes[0] | bytes[1] << 8 | bytes[2] << 16
+            | (uint32_t) bytes[3] << 24;
+    return true;
+}
+
+/*
+ * ===========================================================================
+ * Output functions
+ * ===========================================================================
+ */
+/*
+ * Finds the output format with the given name.
+ *
+ * @param name      name of the format, e.g. "json".
+ * @return the format, or -1 if there is no such format.
+ */
+int format_from_name(char *name) {
+    for (int i = FORMAT_TEXT; i <= FORMAT_QUIET; i++) {
+        if (strcmp(name, formatNames[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Prints the game state as text, one line per player and carriage.
+ *
+ * @param *game     game data that state will be drawn from.
+ * @param to        stream to print to.
+ */
+void print_text_state(Game *game, FILE *to) {
+    // Print player status
+    for (int i = 0; i < game->numPlayers; i++) {
+        fprintf(to, "%c@(%d,%d): $=%d hits=%d\n", game->players[i]->symbol,
+                game->players[i]->pos.x, game->players[i]->pos.y,
+                game->players[i]->loot, game->players[i]->hits);
+    }
+
+    // Print train status/loot remaining, a column per level.
+    for (int i = 0; i < game->numCarriages; i++) {
+        fprintf(to, "Carriage %d: $=%d", i, game->train[i]);
+        for (int y = 1; y < game->numLevels; y++) {
+            fprintf(to, " : $=%d", game->train[train_index(game, i, y)]);
+        }
+        fputc('\n', to);
+    }
+}
+
+/*
+ * Prints the game state as a single JSON object on one line.
+ *
+ * @param *game     game data that state will be drawn from.
+ * @param to        stream to print to.
+ */
+void print_json_state(Game *game, FILE *to) {
+    Player *player;
+
+    fprintf(to, "{\"round\":%d,\"players\":[", game->round - 1);
+    for (int i = 0; i < game->numPlayers; i++) {
+        player = game->players[i];
+        fprintf(to, "%s{\"id\":\"%c\",\"x\":%d,\"y\":%d,\"loot\":%d,"
+                "\"hits\":%d}", i == 0 ? "" : ",", player->symbol,
+                player->pos.x, player->pos.y, player->loot, player->hits);
+    }
+    fprintf(to, "],\"train\":[");
+    for (int i = 0; i < game->numCarriages; i++) {
+        fprintf(to, "%s[%d", i == 0 ? "" : ",", game->train[i]);
+        for (int y = 1; y < game->numLevels; y++) {
+            fprintf(to, ",%d", game->train[train_index(game, i, y)]);
+        }
+        fputc(']', to);
+    }
+    fprintf(to, "]}\n");
+}
+
+/*
+ * Prints the game state as a little endian binary frame:
+ * tag, u16 round, u8 players, u32 carriages, then per player u32 x, u8 y,
+ * u32 loot, u8 hits, then u32 loot of each carriage on each level in
+ * turn, lowest first.
+ *
+ * @param *game     game data that state will be drawn from.
+ * @param to        stream to print to.
+ */
+void print_binary_state(Game *game, FILE *to) {
+    Player *player;
+
+    fputc(FRAME_STATE, to);
+    put_u16(to, game->round - 1);
+    fputc(game->numPlayers, to);
+    put_u32(to, game->numCarriages);
+    for (int i = 0; i < game->numPlayers; i++) {
+        player = game->players[i];
+        put_u32(to, player->pos.x);
+        fputc(player->pos.y, to);
+        put_u32(to, player->loot);
+        fputc(player->hits, to);
+    }
+    for (int i = 0; i < train_size(game); i++) {
+        put_u32(to, game->train[i]);
+    }
+}
+
+/*
+ * Prints the current game state in the given format. Output is left
+ * buffered, callers flush once the round is done.
+ *
+ * @param *game     game data that state will be drawn from.
+ * @param to        stream to print to.
+ * @param format    one of the FORMAT_ constants.
+ */
+void print_game_state(Game *game, FILE *to, int format) {
+    switch (format) {
+        case FORMAT_TEXT:
+            print_text_state(game, to);
+            break;
+        case FORMAT_JSON:
+            print_json_state(game, to);
+            break;
+        case FORMAT_BINARY:
+            print_binary_state(game, to);
+            break;
+    }
+}
+
+/*
+ * Prints the winners of the game in the given format.
+ *
+ * @param to            stream to print to.
+ * @param format        one of the FORMAT_ constants.
+ * @param winners       symbols of the winning players.
+ * @param numWinners    number of winners.
+ */
+void print_winners(FILE *to, int format, char winners[], int numWinners) {
+    if (format == FORMAT_BINARY) {
+        fputc(FRAME_WINNERS, to);
+        fputc(numWinners, to);
+        fwrite(winners, 1, numWinners, to);
+        return;
+    }
+
+    fprintf(to, format == FORMAT_JSON ? "{\"winners\":[" : "Winner(s):");
+    for (int i = 0; i < numWinners; i++) {
+        if (format == FORMAT_JSON) {
+            fprintf(to, "\"%c\"", winners[i]);
+        } else {
+            fprintf(to, "%c", winners[i]);
+        }
+        if (i == numWinners - 1) {
+            fprintf(to, format == FORMAT_JSON ? "]}\n" : "\n");
+        } else {
+            fprintf(to, ",");
+        }
+    }
+}
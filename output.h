@@ -0,0 +1,79 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "shared.h"
+
+/*
+ * ===========================================================================
+ * Output header file - game state reporting in several formats.
+ * ===========================================================================
+ */
+
+/* Output formats */
+#define FORMAT_TEXT 0
+#define FORMAT_JSON 1
+#define FORMAT_BINARY 2
+#define FORMAT_QUIET 3
+
+/* Size of stdout buffer, so a round usually leaves in one write */
+#define OUTPUT_BUFFER_SIZE 65536
+
+/* Binary frame tags */
+#define FRAME_STATE 'S'
+#define FRAME_WINNERS 'W'
+#define FRAME_STATS 'T'
+
+/*
+ * ===========================================================================
+ * Output functions
+ * ===========================================================================
+ */
+/*
+ * Writes a 32 bit value in little endian order.
+ *
+ * @param to        stream to write to.
+ * @param value     the value to write.
+ */
+void put_u32(FILE *to, uint32_t value);
+
+/*
+ * Reads a 32 bit value in little endian order.
+ *
+ * @param from      stream to read from.
+ * @param *value    where to store the value.
+ * @return true if read, false at end of file.
+ */
+bool get_u32(FILE *from, uint32_t *value);
+
+/*
+ * Finds the output format with the given name.
+ *
+ * @param name      name of the format, e.g. "json".
+ * @return the format, or -1 if there is no such format.
+ */
+int format_from_name(char *name);
+
+/*
+ * Prints the current game state in the given format. Output is left
+ * buffered, callers flush once the round is done.
+ *
+ * @param *game     game data that state will be drawn from.
+ * @param to        stream to print to.
+ * @param format    one of the FORMAT_ constants.
+ */
+void print_game_state(Game *game, FILE *to, int format);
+
+/*
+ * Prints the winners of the game in the given format.
+ *
+ * @param to            stream to print to.
+ * @param format        one of the FORMAT_ constants.
+ * @param winners       symbols of the winning players.
+ * @param numWinners    number of winners.
+ */
+void print_winners(FILE *to, int format, char winners[], int numWinners);
+
+#endif
@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <string.h>
+#include "packed.h"
+#include "comms.h"
+
+/*
+ * ===========================================================================
+ * CSSE2310 Assignment 3
+ * PACKED - Fixed size game states
+ * ===========================================================================
+ */
+
+/* Function prototypes local to packed */
+uint8_t pack_orders(char orders[]);
+void unpack_orders(uint8_t packed, char orders[]);
+
+/*
+ * Packs a player's last orders into a byte, see PACKED_ORDER.
+ *
+ * @param orders    order type and direction, '\0' if none.
+ * @return the packed orders.
+ */
+uint8_t pack_orders(char orders[]) {
+    char *order = orders[0] == '\0' ? NULL : strchr(VALID_MOVES, orders[0]);
+    uint8_t packed = order == NULL ? 0 : order - VALID_MOVES + 1;
+
+    if (orders[1] == DIR_LEFT) {
+        packed |= 1 << 3;
+    } else if (orders[1] == DIR_RIGHT) {
+        packed |= 2 << 3;
+    }
+    return packed;
+}
+
+/*
+ * Unpacks a player's last orders from a byte.
+ *
+ * @param packed    the packed orders.
+ * @param orders    where to store the order type and direction.
+ */
+void unpack_orders(uint8_t packed, char orders[]) {
+    int order = PACKED_ORDER(packed), direction = PACKED_DIRECTION(packed);
+
+    orders[0] = order == 0 ? '\0' : VALID_MOVES[order - 1];
+    orders[1] = direction == 1 ? DIR_LEFT : direction == 2 ? DIR_RIGHT
+            : '\0';
+}
+
+/*
+ * Packs the state of a game. Hits above PACKED_MAX_HITS are kept as
+ * PACKED_MAX_HITS, which the rules can't tell apart: a player with 3 or
+ * more hits dries out.
+ *
+ * @param *game     the game to pack.
+ * @param *packed   where to store the packed game.
+ * @return true if packed, false if the train is too wide or has other
+ *         than two levels, or a player or train spot has more than
+ *         PACKED_MAX_LOOT loot.
+ */
+bool pack_game(Game *game, PackedGame *packed) {
+    Player *player;
+    int hits;
+
+    if (game->numCarriages > PACKED_MAX_CARRIAGES
+            || game->numLevels != PACKED_LEVELS) {
+        return false;
+    }
+    memset(packed, 0, sizeof(PackedGame));
+    packed->numPlayers = game->numPlayers;
+    packed->numCarriages = game->numCarriages;
+    for (int i = 0; i < game->numPlayers; i++) {
+        player = game->players[i];
+        if (player->loot > PACKED_MAX_LOOT) {
+            return false;
+        }
+        hits = player->hits > PACKED_MAX_HITS ? PACKED_MAX_HITS
+                : player->hits;
+        packed->players[i] = PACKED_PLAYER(player->pos.x, player->pos.y,
+                hits, player->loot);
+        packed->orders[i] = pack_orders(player->orders);
+    }
+    // Lower level first, as the game keeps it, at a fixed stride.
+    for (int i = 0; i < train_size(game); i++) {
+        if (game->train[i] > PACKED_MAX_LOOT) {
+            return false;
+        }
+        packed->train[i / game->numCarriages * PACKED_MAX_CARRIAGES
+                + i % game->numCarriages] = game->train[i];
+    }
+    return true;
+}
+
+/*
+ * Unpacks a packed game into a game of the same size, updating its hash.
+ *
+ * @param *packed   the packed game.
+ * @param *game     game made with make_game for the same players and
+ *                  carriages.
+ */
+void unpack_game(PackedGame *packed, Game *game) {
+    Player *player;
+    uint16_t bits;
+
+    for (int i = 0; i < game->numPlayers; i++) {
+        player = game->players[i];
+        bits = packed->players[i];
+        player->pos.x = PACKED_X(bits);
+        player->pos.y = PACKED_Y(bits);
+        player->hits = PACKED_HITS(bits);
+        player->loot = PACKED_LOOT(bits);
+        unpack_orders(packed->orders[i], player->orders);
+    }
+    for (int i = 0; i < train_size(game); i++) {
+        game->train[i] = packed->train[i / game->numCarriages
+                * PACKED_MAX_CARRIAGES + i % game->numCarriages];
+    }
+    game->hash = hash_game(game);
+    index_loot(game);
+}
+
+/*
+ * Checks if two packed games hold the same state.
+ *
+ * @param *first    a packed game.
+ * @param *second   another packed game.
+ * @return true if they match, else false.
+ */
+bool packed_equal(PackedGame *first, PackedGame *second) {
+    return memcmp(first, second, sizeof(PackedGame)) == 0;
+}
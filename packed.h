@@ -0,0 +1,91 @@
+#ifndef PACKED_H
+#define PACKED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "shared.h"
+
+/*
+ * ===========================================================================
+ * Packed game header file - a fixed size copy of a game's state, for
+ * simulating and comparing many states cheaply.
+ * ===========================================================================
+ */
+
+/* Widest train a packed game holds, sized so a packed game fills two
+ * 64 byte cache lines exactly */
+#define PACKED_MAX_CARRIAGES 24
+/* Packed players have one bit for their level */
+#define PACKED_LEVELS 2
+#define PACKED_ALIGN 64
+
+/* Each player is 16 bits: x (5 bits), level (1), hits (2), loot (8) */
+#define PACKED_X(player) ((player) & 0x1F)
+#define PACKED_Y(player) ((player) >> 5 & 1)
+#define PACKED_HITS(player) ((player) >> 6 & 3)
+#define PACKED_LOOT(player) ((player) >> 8)
+#define PACKED_PLAYER(x, y, hits, loot) \
+        ((x) | (y) << 5 | (hits) << 6 | (loot) << 8)
+#define PACKED_MAX_HITS 3
+#define PACKED_MAX_LOOT 255
+
+/* Each player's last orders are a byte: order (3 bits, 0 if none, else
+ * 1 + index in VALID_MOVES) and direction (2 bits, 0 none, 1 left,
+ * 2 right) */
+#define PACKED_ORDER(orders) ((orders) & 7)
+#define PACKED_DIRECTION(orders) ((orders) >> 3 & 3)
+
+/* Typedef Structs for readability */
+typedef struct PackedGameInfo PackedGame;
+
+/* State of a game, without its players' processes or plans. Unused
+ * players and train spots are zero, so packed games can be compared as
+ * bytes. */
+struct PackedGameInfo {
+    uint8_t numPlayers;
+    uint8_t numCarriages;
+    // Position, hits and loot of each player, see PACKED_PLAYER.
+    uint16_t players[MAX_PLAYERS];
+    // Last orders of each player, see PACKED_ORDER.
+    uint8_t orders[MAX_PLAYERS];
+    // Loot in each lower carriage, then each upper carriage.
+    uint8_t train[PACKED_LEVELS * PACKED_MAX_CARRIAGES];
+} __attribute__((aligned(PACKED_ALIGN)));
+
+/*
+ * ===========================================================================
+ * Packed game functions
+ * ===========================================================================
+ */
+/*
+ * Packs the state of a game. Hits above PACKED_MAX_HITS are kept as
+ * PACKED_MAX_HITS, which the rules can't tell apart: a player with 3 or
+ * more hits dries out.
+ *
+ * @param *game     the game to pack.
+ * @param *packed   where to store the packed game.
+ * @return true if packed, false if the train is too wide or has other
+ *         than two levels, or a player or train spot has more than
+ *         PACKED_MAX_LOOT loot.
+ */
+bool pack_game(Game *game, PackedGame *packed);
+
+/*
+ * Unpacks a packed game into a game of the same size, updating its hash.
+ *
+ * @param *packed   the packed game.
+ * @param *game     game made with make_game for the same players and
+ *                  carriages.
+ */
+void unpack_game(PackedGame *packed, Game *game);
+
+/*
+ * Checks if two packed games hold the same state.
+ *
+ * @param *first    a packed game.
+ * @param *second   another packed game.
+ * @return true if they match, else false.
+ */
+bool packed_equal(PackedGame *first, PackedGame *second);
+
+#endif
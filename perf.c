@@ -0,0 +1,247 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perf.h"
+
+/*
+ * ===========================================================================
+ * CSSE2310 Assignment 3
+ * PERF - Hardware counters around hub phases
+ * ===========================================================================
+ */
+
+// File counts are written to, NULL if not counting.
+FILE *perfFile;
+// The hub and any players being counted
+Target targets[PERF_MAX_TARGETS];
+int numTargets;
+// Phase being counted, one of the PERF_ constants
+int perfPhase = PERF_NONE;
+// Phases entered this round, only these are written
+bool entered[PERF_PHASES];
+
+/* Names of counters and phases, as written in the counts file */
+const char *counterNames[] = {"cycles", "instructions", "cache_misses",
+        "branch_misses", "context_switches"};
+const char *phaseNames[] = {"orders", "execution", "sync", "report"};
+
+/* Function prototypes local to perf */
+int open_counter(pid_t pid, int counter);
+void add_target(pid_t pid, char *name);
+long long read_counter_fd(int fd);
+
+/*
+ * Opens a counter of a process. Counting the kernel as well needs more
+ * permission, so user space alone is counted if that is all allowed.
+ * Players are counted with the children they start, the hub without
+ * the players it forks.
+ *
+ * @param pid       the process, 0 for the hub itself.
+ * @param counter   which counter, one of the PERF_ counter constants.
+ * @return the counter's file descriptor, -1 if it can't be opened.
+ */
+int open_counter(pid_t pid, int counter) {
+    uint64_t configs[] = {PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_SW_CONTEXT_SWITCHES};
+    struct perf_event_attr attr;
+    int fd = -1;
+
+    for (int user = 0; user <= 1 && fd == -1; user++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counter == PERF_SWITCHES ? PERF_TYPE_SOFTWARE
+                : PERF_TYPE_HARDWARE;
+        attr.config = configs[counter];
+        // Counters are shared with other events, so counts are scaled
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+                | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.inherit = pid != 0;
+        attr.exclude_kernel = user;
+        attr.exclude_hv = 1;
+        fd = syscall(SYS_perf_event_open, &attr, pid, -1, -1,
+                PERF_FLAG_FD_CLOEXEC);
+    }
+    return fd;
+}
+
+/*
+ * Starts counting a process.
+ *
+ * @param pid       the process, 0 for the hub itself.
+ * @param name      name written with its rows.
+ */
+void add_target(pid_t pid, char *name) {
+    Target *target;
+
+    if (numTargets == PERF_MAX_TARGETS) {
+        return;
+    }
+    target = &targets[numTargets++];
+    memset(target, 0, sizeof(Target));
+    snprintf(target->name, sizeof(target->name), "%s", name);
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+        target->fds[i] = open_counter(pid, i);
+    }
+}
+
+/*
+ * Reads a counter, scaled up for any time it wasn't running.
+ *
+ * @param fd        the counter's file descriptor.
+ * @return the count, 0 if it can't be read.
+ */
+long long read_counter_fd(int fd) {
+    // Value, time enabled and time running
+    uint64_t values[3];
+
+    if (read(fd, values, sizeof(values)) != sizeof(values)
+            || values[2] == 0) {
+        return 0;
+    }
+    return (long long) ((double) values[0] * values[1] / values[2]);
+}
+
+/*
+ * Starts counting the hub, writing a CSV row of each phase's counts to
+ * path every round. Counters the kernel won't open are left empty.
+ *
+ * @param path      file to write counts to.
+ * @return true if counting started, false if the file can't be opened.
+ */
+bool perf_open(char *path) {
+    if ((perfFile = fopen(path, "w")) == NULL) {
+        return false;
+    }
+    fprintf(perfFile, "round,phase,process");
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+        fprintf(perfFile, ",%s", counterNames[i]);
+    }
+    fprintf(perfFile, "\n");
+    fflush(perfFile);
+
+    add_target(0, "hub");
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+        if (targets[0].fds[i] == -1) {
+            fprintf(stderr, "Perf counter %s unavailable\n",
+                    counterNames[i]);
+        }
+    }
+    return true;
+}
+
+/*
+ * Checks if counting is on.
+ *
+ * @return true if phases are being counted.
+ */
+bool perf_counting(void) {
+    return perfFile != NULL;
+}
+
+/*
+ * Starts counting a player process and any children it starts.
+ *
+ * @param pid       the player's process.
+ * @param symbol    the player's symbol.
+ */
+void perf_add_player(pid_t pid, char symbol) {
+    char name[] = {symbol, '\0'};
+
+    if (perf_counting()) {
+        add_target(pid, name);
+    }
+}
+
+/*
+ * Samples every counter, adding what was counted since the last sample
+ * to the phase that is ending, then starts the next phase.
+ *
+ * @param phase     the phase starting, PERF_NONE if none.
+ */
+void perf_phase(int phase) {
+    Target *target;
+    long long now;
+
+    if (!perf_counting()) {
+        return;
+    }
+    for (int i = 0; i < numTargets; i++) {
+        target = &targets[i];
+        for (int j = 0; j < PERF_COUNTERS; j++) {
+            if (target->fds[j] == -1) {
+                continue;
+            }
+            now = read_counter_fd(target->fds[j]);
+            if (perfPhase != PERF_NONE) {
+                target->counts[perfPhase][j] += now - target->last[j];
+            }
+            target->last[j] = now;
+        }
+    }
+    perfPhase = phase;
+    if (phase != PERF_NONE) {
+        entered[phase] = true;
+    }
+}
+
+/*
+ * Ends a round, writing a row for each process and phase of the round
+ * and starting the next round's counts from zero.
+ *
+ * @param round     the round that ended.
+ */
+void perf_round(int round) {
+    Target *target;
+
+    if (!perf_counting()) {
+        return;
+    }
+    perf_phase(PERF_NONE);
+    for (int phase = 0; phase < PERF_PHASES; phase++) {
+        for (int i = 0; i < numTargets && entered[phase]; i++) {
+            target = &targets[i];
+            fprintf(perfFile, "%d,%s,%s", round, phaseNames[phase],
+                    target->name);
+            // Counters that couldn't be opened are left empty
+            for (int j = 0; j < PERF_COUNTERS; j++) {
+                if (target->fds[j] == -1) {
+                    fprintf(perfFile, ",");
+                } else {
+                    fprintf(perfFile, ",%lld", target->counts[phase][j]);
+                }
+                target->counts[phase][j] = 0;
+            }
+            fprintf(perfFile, "\n");
+        }
+        entered[phase] = false;
+    }
+    // Written now, so forked players never have rows to flush
+    fflush(perfFile);
+}
+
+/*
+ * Stops counting and closes the counts file, forgetting every target so
+ * counting can be started again, e.g. in a forked process.
+ */
+void perf_close(void) {
+    if (!perf_counting()) {
+        return;
+    }
+    for (int i = 0; i < numTargets; i++) {
+        for (int j = 0; j < PERF_COUNTERS; j++) {
+            if (targets[i].fds[j] != -1) {
+                close(targets[i].fds[j]);
+            }
+        }
+    }
+    fclose(perfFile);
+    perfFile = NULL;
+    numTargets = 0;
+    perfPhase = PERF_NONE;
+    memset(entered, 0, sizeof(entered));
+}
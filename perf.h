@@ -0,0 +1,100 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+/*
+ * ===========================================================================
+ * Perf header file - hardware counters of the hub and players, split by
+ * the phases of each round.
+ * ===========================================================================
+ */
+
+/* Counters kept for each process, in the order they are written */
+#define PERF_CYCLES 0
+#define PERF_INSTRUCTIONS 1
+#define PERF_CACHE_MISSES 2
+#define PERF_BRANCH_MISSES 3
+#define PERF_SWITCHES 4
+#define PERF_COUNTERS 5
+
+/* Phases of a round counters are split by, PERF_NONE between rounds */
+#define PERF_NONE -1
+#define PERF_ORDERS 0
+#define PERF_EXECUTE 1
+#define PERF_SYNC 2
+#define PERF_REPORT 3
+#define PERF_PHASES 4
+
+/* The hub and each of up to 26 players */
+#define PERF_MAX_TARGETS 27
+
+/* Typedef Structs for readability */
+typedef struct PerfTarget Target;
+
+/* A process being counted */
+struct PerfTarget {
+    // Name written with its rows, "hub" or the player's symbol.
+    char name[4];
+    // Counter file descriptors, -1 for counters that couldn't be opened.
+    int fds[PERF_COUNTERS];
+    // Counts when last sampled.
+    long long last[PERF_COUNTERS];
+    // Counts in each phase of this round.
+    long long counts[PERF_PHASES][PERF_COUNTERS];
+};
+
+/*
+ * ===========================================================================
+ * Perf functions
+ * ===========================================================================
+ */
+/*
+ * Starts counting the hub, writing a CSV row of each phase's counts to
+ * path every round. Counters the kernel won't open are left empty.
+ *
+ * @param path      file to write counts to.
+ * @return true if counting started, false if the file can't be opened.
+ */
+bool perf_open(char *path);
+
+/*
+ * Checks if counting is on.
+ *
+ * @return true if phases are being counted.
+ */
+bool perf_counting(void);
+
+/*
+ * Starts counting a player process and any children it starts.
+ *
+ * @param pid       the player's process.
+ * @param symbol    the player's symbol.
+ */
+void perf_add_player(pid_t pid, char symbol);
+
+/*
+ * Samples every counter, adding what was counted since the last sample
+ * to the phase that is ending, then starts the next phase.
+ *
+ * @param phase     the phase starting, PERF_NONE if none.
+ */
+void perf_phase(int phase);
+
+/*
+ * Ends a round, writing a row for each process and phase of the round
+ * and starting the next round's counts from zero.
+ *
+ * @param round     the round that ended.
+ */
+void perf_round(int round);
+
+/*
+ * Stops counting and closes the counts file, forgetting every target so
+ * counting can be started again, e.g. in a forked process.
+ */
+void perf_close(void);
+
+#endif
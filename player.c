@@ -1,8 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
 #include "player.h"
 #include "comms.h"
+#include "logging.h"
+#include "sockets.h"
 
 /*
  * ===========================================================================
@@ -22,10 +26,16 @@
  * @params exitStatus   the exit code associated with exit handler call.
  */
 void handle_exit(int exitStatus) {
+    // Show what led up to an error
+    if (exitStatus != EXIT_SUCCESS) {
+        log_dump(stderr);
+    }
+
     switch(exitStatus) {
         case WRONG_ARGS:
             // Wrong number of arguments
-            fprintf(stderr, "Usage: player pcount myid width seed\n");
+            fprintf(stderr,
+                    "Usage: player pcount myid width seed [levels rounds]\n");
             break;
 
         case INVALID_PLAYERS:
@@ -48,6 +58,11 @@ void handle_exit(int exitStatus) {
             fprintf(stderr, "Invalid seed\n");
             break;
 
+        case INVALID_SHAPE:
+            // Invalid number of levels or rounds
+            fprintf(stderr, "Invalid levels or rounds\n");
+            break;
+
         case COMMS_ERROR:
             // Pipe closed or invalid message
             fprintf(stderr, "Communication Error\n");
@@ -70,8 +85,8 @@ void handle_exit(int exitStatus) {
 void update_dry(Game *game, int player) {
     char symbol = game->players[player]->symbol;
     // Dry out
-    game->players[player]->hits = 0;
-    fprintf(stderr, "%c dries off\n", symbol);
+    change_hits(game, player, -game->players[player]->hits);
+    player_log(LOG_EVENT, "%c dries off", symbol);
 
     // Update orders
     game->players[player]->orders[0] = DRY;
@@ -86,53 +101,18 @@ void update_dry(Game *game, int player) {
  * @param target    target id
  */
 void update_shot_l(Game *game, int player, int target) {
-    char pSymbol = game->players[player]->symbol, tSymbol;
-    Position playerPos, targetPos, tempPos;
-    int noShot, level;
-    if (target != -1) {
-        // Handle long
-        tSymbol = game->players[target]->symbol;
-        playerPos = game->players[player]->pos;
-        targetPos = game->players[target]->pos;
-
-        if (playerPos.y == 0 && targetPos.y == 0) {
-            level = 0;
-        } else if (playerPos.y == 1 && targetPos.y == 1) {
-            level = 1;
-        }
+    char pSymbol = game->players[player]->symbol;
+    Legal legal;
 
-        if (level == 0 && playerPos.x != targetPos.x &&
-                (targetPos.x == playerPos.x + 1
-                || targetPos.x == playerPos.x - 1) && targetPos.x >= 0
-                && targetPos.x < game->numCarriages) {
-            // Has shot on lower level
-            noShot = 0;
-        } else if (level == 1 && playerPos.x != targetPos.x) {
-            // Has shot on upper level
-            noShot = 0;
-            // Check no other player is closer, cancelling shot
-            for (int i = 0; i < game->numPlayers; i++) {
-                tempPos = game->players[i]->pos;
-                // Only check for players on the same level
-                if (i != player && i != target && tempPos.y == 1) {
-                    if ((targetPos.x > playerPos.x && targetPos.x > tempPos.x)
-                            || (targetPos.x < playerPos.x
-                            && targetPos.x < tempPos.x)) {
-                        noShot = 1;
-                    }
-                }
-            }
-        }
-    } else {
-        noShot = 1;
-    }
+    find_legal(game, player, &legal);
     // Do we have a shot?
-    if (noShot) {
-        fprintf(stderr, "%c has no target\n", pSymbol);
+    if (target == -1 || !(legal.longTargets >> target & 1)) {
+        player_log(LOG_EVENT, "%c has no target", pSymbol);
     } else {
-        game->players[target]->hits++;
-        fprintf(stderr, "%c targets %c who has %d hits\n",
-                pSymbol, tSymbol, game->players[target]->hits);
+        change_hits(game, target, 1);
+        player_log(LOG_EVENT, "%c targets %c who has %d hits",
+                pSymbol, game->players[target]->symbol,
+                game->players[target]->hits);
     }
     game->players[player]->orders[0] = SHOOT_L;
 }
@@ -146,30 +126,28 @@ void update_shot_l(Game *game, int player, int target) {
  */
 void update_shot_s(Game *game, int player, int target) {
     char pSymbol = game->players[player]->symbol, tSymbol;
-    Position playerPos, targetPos;
-    if (target != -1) {
+    Position targetPos;
+    Legal legal;
+
+    find_legal(game, player, &legal);
+    if (target != -1 && (legal.shortTargets >> target & 1)) {
         tSymbol = game->players[target]->symbol;
-        playerPos = game->players[player]->pos;
         targetPos = game->players[target]->pos;
-
-        // Handle short
-        if (playerPos.x == targetPos.x && playerPos.y == targetPos.y) {
-            if (game->players[target]->loot > 0) {
-                // Target hit and drops loot
-                game->players[target]->loot--;
-                game->train[targetPos.y * game->numCarriages + targetPos.x]++;
-                fprintf(stderr, "%c makes %c drop loot\n", pSymbol, tSymbol);
-            } else {
-                // Target hit by no loot to drop!
-                fprintf(stderr,
-                        "%c tries to make %c drop loot they don't have\n",
-                        pSymbol, tSymbol);
-            }
+        if (game->players[target]->loot > 0) {
+            // Target hit and drops loot
+            change_loot(game, target, -1);
+            change_train(game, train_index(game, targetPos.x, targetPos.y),
+                    1);
+            player_log(LOG_EVENT, "%c makes %c drop loot",
+                    pSymbol, tSymbol);
         } else {
-            fprintf(stderr, "%c has no target\n", pSymbol);
+            // Target hit by no loot to drop!
+            player_log(LOG_EVENT,
+                    "%c tries to make %c drop loot they don't have",
+                    pSymbol, tSymbol);
         }
     } else {
-        fprintf(stderr, "%c has no target\n", pSymbol);
+        player_log(LOG_EVENT, "%c has no target", pSymbol);
     }
 
     // Update orders
@@ -185,18 +163,18 @@ void update_shot_s(Game *game, int player, int target) {
 void update_loot(Game *game, int player) {
     char pSymbol = game->players[player]->symbol;
     Position currentPos = game->players[player]->pos;
-    int index = currentPos.y * game->numCarriages + currentPos.x;
+    int index = train_index(game, currentPos.x, currentPos.y);
 
     if (game->train[index] > 0) {
         // Found loot
-        game->train[index]--;
-        game->players[player]->loot++;
-        fprintf(stderr, "%c picks up loot (they now have %d)\n",
+        change_train(game, index, -1);
+        change_loot(game, player, 1);
+        player_log(LOG_EVENT, "%c picks up loot (they now have %d)",
                 pSymbol, game->players[player]->loot);
     } else {
         // No loot
-        fprintf(stderr,
-                "%c tries to pick up loot but there isn't any\n", pSymbol);
+        player_log(LOG_EVENT,
+                "%c tries to pick up loot but there isn't any", pSymbol);
     }
 
     // Update orders tracking
@@ -215,19 +193,17 @@ void update_move(Game *game, int player, char direction) {
     char pSymbol = game->players[player]->symbol;
 
     // Update position if applicable
-    if (direction == MOVE_V && currentPos.y == 0) {
-        // Move up
-        game->players[player]->pos.y = 1;
-    } else if (direction == MOVE_V && currentPos.y == 1) {
-        // Move down
-        game->players[player]->pos.y = 0;
+    if (direction == MOVE_V) {
+        // Move up, or down to the bottom from the top
+        move_player(game, player, currentPos.x,
+                next_level(game, currentPos.y));
     } else if (direction == DIR_LEFT && currentPos.x > 0) {
         // Player moves if not at left most carriage
-        game->players[player]->pos.x--;
+        move_player(game, player, currentPos.x - 1, currentPos.y);
     } else if (direction == DIR_RIGHT &&
             currentPos.x < game->numCarriages - 1) {
         // Player moves if not at right most carriage
-        game->players[player]->pos.x++;
+        move_player(game, player, currentPos.x + 1, currentPos.y);
     }
 
     // Update last orders
@@ -238,10 +214,156 @@ void update_move(Game *game, int player, char direction) {
         game->players[player]->orders[1] = direction;
     }
 
-    fprintf(stderr, "%c moved to %d/%d\n", pSymbol,
+    player_log(LOG_EVENT, "%c moved to %d/%d", pSymbol,
             game->players[player]->pos.x, game->players[player]->pos.y);
 }
 
+/*
+ * Runs an action in place by the same rules as the update functions,
+ * without logging, and records how to take it back. For strategies that
+ * search ahead without copying the game.
+ *
+ * @param *game     the game being searched.
+ * @param player    the player acting.
+ * @param action    the action, which must be legal.
+ * @param *undo     where to record what changed.
+ */
+void do_action(Game *game, int player, Action action, Undo *undo) {
+    Player *actor = game->players[player];
+    int target = action.param - 'A';
+    int cell = train_index(game, actor->pos.x, actor->pos.y);
+
+    undo->actor = player;
+    memcpy(undo->orders, actor->orders, 2);
+    undo->id = player;
+    undo->pos = actor->pos;
+    undo->loot = 0;
+    undo->hits = 0;
+    undo->train = 0;
+    switch (action.order) {
+        case DRY:
+            undo->hits = -actor->hits;
+            break;
+        case LOOT:
+            if (game->train[cell] > 0) {
+                undo->loot = 1;
+                undo->cell = cell;
+                undo->train = -1;
+            }
+            break;
+        case SHOOT_S:
+            if (action.param != NO_TARGET
+                    && game->players[target]->loot > 0) {
+                // Target drops loot where it stands
+                undo->id = target;
+                undo->pos = game->players[target]->pos;
+                undo->loot = -1;
+                undo->cell = train_index(game, undo->pos.x, undo->pos.y);
+                undo->train = 1;
+            }
+            break;
+        case SHOOT_L:
+            if (action.param != NO_TARGET) {
+                undo->id = target;
+                undo->pos = game->players[target]->pos;
+                undo->hits = 1;
+            }
+            break;
+        case MOVE_V:
+            move_player(game, player, actor->pos.x,
+                    next_level(game, actor->pos.y));
+            break;
+        case MOVE_H:
+            move_player(game, player, actor->pos.x
+                    + (action.param == DIR_LEFT ? -1 : 1), actor->pos.y);
+            actor->orders[1] = action.param;
+            break;
+    }
+    actor->orders[0] = action.order;
+    if (undo->loot != 0) {
+        change_loot(game, undo->id, undo->loot);
+    }
+    if (undo->hits != 0) {
+        change_hits(game, undo->id, undo->hits);
+    }
+    if (undo->train != 0) {
+        change_train(game, undo->cell, undo->train);
+    }
+}
+
+/*
+ * Takes back an action run by do_action, leaving the game and its hash
+ * exactly as they were. Actions must be undone in reverse order.
+ *
+ * @param *game     the game being searched.
+ * @param *undo     what do_action recorded.
+ */
+void undo_action(Game *game, Undo *undo) {
+    Position pos = game->players[undo->id]->pos;
+
+    memcpy(game->players[undo->actor]->orders, undo->orders, 2);
+    if (pos.x != undo->pos.x || pos.y != undo->pos.y) {
+        move_player(game, undo->id, undo->pos.x, undo->pos.y);
+    }
+    if (undo->loot != 0) {
+        change_loot(game, undo->id, -undo->loot);
+    }
+    if (undo->hits != 0) {
+        change_hits(game, undo->id, -undo->hits);
+    }
+    if (undo->train != 0) {
+        change_train(game, undo->cell, -undo->train);
+    }
+}
+
+/*
+ * Applies a state message from the hub, setting the round and then each
+ * player and train spot listed.
+ *
+ * @param *game     the player's view of the game state.
+ * @param message   the state message sent by the hub.
+ */
+void apply_state(Game *game, char message[]) {
+    char *entry = message + strlen(STATE), symbol, orders[2];
+    int x, y, loot, hits, index, length, id;
+    Player *player;
+
+    game->round = strtol(entry, &entry, 10);
+    while (*entry == STATE_SEPARATOR) {
+        entry++;
+        if (sscanf(entry, "#%d=%d%n", &index, &loot, &length) == 2) {
+            // Train spot
+            if (index < 0 || index >= train_size(game) || loot < 0) {
+                handle_exit(COMMS_ERROR);
+            }
+            change_train(game, index, loot - game->train[index]);
+        } else if (sscanf(entry, "%c=%d,%d,%d,%d,%c%c%n", &symbol, &x, &y,
+                &loot, &hits, &orders[0], &orders[1], &length) == 7) {
+            // Player
+            id = symbol - 'A';
+            if (id < 0 || id >= game->numPlayers || x < 0
+                    || x >= game->numCarriages || y < 0
+                    || y >= game->numLevels) {
+                handle_exit(COMMS_ERROR);
+            }
+            player = game->players[id];
+            move_player(game, id, x, y);
+            change_loot(game, id, loot - player->loot);
+            change_hits(game, id, hits - player->hits);
+            for (int i = 0; i < 2; i++) {
+                player->orders[i] = orders[i] == STATE_NO_ORDER ? '\0'
+                        : orders[i];
+            }
+        } else {
+            handle_exit(COMMS_ERROR);
+        }
+        entry += length;
+    }
+    if (*entry != '\0') {
+        handle_exit(COMMS_ERROR);
+    }
+}
+
 /*
  * Updates the state of the game for the players, based on
  * declared action by hub in execute phase.
@@ -306,24 +428,43 @@ void update_state(Game *game, char message[]) {
 void action_message(Game *game, char message[], int id) {
     int length = strlen(message);
 
-    if (strcmp(message, GAME_OVER) == 0) {
-        handle_exit(EXIT_SUCCESS);
-    } else if (strcmp(message, NEW_ROUND) == 0) {
+    if (strcmp(message, NEW_ROUND) == 0) {
         game->execute = false;
         game->round++;
-    } else if (strcmp(message, GET_ACTION) == 0) {
+        // Forget last round's announced orders
+        for (int i = 0; i < game->numPlayers; i++) {
+            game->players[i]->newOrders[0] = '\0';
+        }
+    } else if (strncmp(message, GET_ACTION, strlen(GET_ACTION)) == 0) {
+        // The hub may have worked out what we can do already
+        if (strcmp(message, GET_ACTION) != 0) {
+            if (!read_legal(message + strlen(GET_ACTION),
+                    &game->players[id]->legal)) {
+                handle_exit(COMMS_ERROR);
+            }
+            game->legalFor = id;
+        }
         choose_move(game, id);
+        game->legalFor = -1;
+    } else if (strncmp(message, STATE, strlen(STATE)) == 0) {
+        apply_state(game, message);
     } else if (strstr(message, ORDERED) != NULL) {
         char player = message[length - 2];
         int order = message[length - 1];
-        if ((player - 'A') >= game->numPlayers
+        if (player < 'A' || (player - 'A') >= game->numPlayers
                 || strchr(VALID_MOVES, order) == NULL) {
             handle_exit(COMMS_ERROR);
         }
-        fprintf(stderr, "%c ordered %c\n", message[length - 2],
+        player_log(LOG_DEBUG, "%c ordered %c", message[length - 2],
                 message[length - 1]);
+        game->players[player - 'A']->newOrders[0] = order;
     } else if (strcmp(message, EXECUTE) == 0) {
         game->execute = true;
+    } else if (strcmp(message, SYNC) == 0) {
+        // Tell the hub what we think the game looks like
+        char hash[HASH_DIGITS + 1];
+        sprintf(hash, "%016" PRIx64, game->hash);
+        send_message(stdout, HASH, hash);
     } else if (strcmp(message, GET_DIR) == 0
             || strcmp(message, GET_S_TARGET) == 0
             || strcmp(message, GET_L_TARGET) == 0) {
@@ -342,16 +483,17 @@ void action_message(Game *game, char message[], int id) {
 
 /*
  * Main player game loop to receive and handle messages.
+ * Returns once the hub says the game is over.
  *
  * @param *game     game struct with player view of game state
  * @param id        the id of this player
  */
 void player_game_loop(Game *game, int id) {
-    char message[MSG_MAX_LEN];
+    char message[EXT_MSG_MAX_LEN];
 
     while(1) {
         // Listen for messages from hub
-        if (fgets(message, MSG_MAX_LEN, stdin) == NULL) {
+        if (fgets(message, EXT_MSG_MAX_LEN, stdin) == NULL) {
             handle_exit(COMMS_ERROR);
         }
         // Clean up message, we don't need newline
@@ -359,8 +501,10 @@ void player_game_loop(Game *game, int id) {
             message[strlen(message) - 1] = '\0';
         }
 
-        // Check hub sent a valid message.
-        if (!hub_message_valid(message)) {
+        // Check hub sent a valid message, the game may be over.
+        if (strcmp(message, GAME_OVER) == 0) {
+            return;
+        } else if (!hub_message_valid(message)) {
             handle_exit(COMMS_ERROR);
         } else {
             action_message(game, message, id);
@@ -368,6 +512,24 @@ void player_game_loop(Game *game, int id) {
     }
 }
 
+/*
+ * Gets the legal actions of a player, using those the hub sent with
+ * 'yourturn' when there are some.
+ *
+ * @param *game     current game state
+ * @param id        the player acting
+ * @return the player's legal actions.
+ */
+Legal legal_actions(Game *game, int id) {
+    Legal legal;
+
+    if (game->legalFor == id) {
+        return game->players[id]->legal;
+    }
+    find_legal(game, id, &legal);
+    return legal;
+}
+
 /*
  * Checks if another player is in the same carriage as player.
  *
@@ -376,19 +538,8 @@ void player_game_loop(Game *game, int id) {
  * @return true if a player is found in same carriage, else false
  */
 bool player_here(Game *game, int id) {
-    Position playerPos = game->players[id]->pos;
-    Position checkPos;
-
-    for (int i = 0; i < game->numPlayers; i++) {
-        checkPos = game->players[i]->pos;
-        if (i != id && checkPos.y == playerPos.y
-                && checkPos.x == playerPos.x) {
-            return true;
-        }
-    }
-
-    // No players found
-    return false;
+    return targets_here(game, id, legal_actions(game, id).shortTargets)
+            != 0;
 }
 
 /*
@@ -399,27 +550,7 @@ bool player_here(Game *game, int id) {
  * @return true if long target found, else false
  */
 bool has_long_target(Game *game, int id) {
-    Position playerPos = game->players[id]->pos;
-    Position checkPos;
-
-    // Check for long targets
-    for (int i = 0; i < game->numPlayers; i++) {
-        checkPos = game->players[i]->pos;
-        // Check lower level criteria
-        if (i != id && (checkPos.x == playerPos.x - 1
-                || checkPos.x == playerPos.x + 1) && checkPos.x >= 0
-                && checkPos.x < game->numCarriages
-                && checkPos.y == playerPos.y && playerPos.y == 0) {
-            return true;
-        } else if (i != id && (checkPos.x < playerPos.x
-                || checkPos.x > playerPos.x) && checkPos.y == playerPos.y
-                && playerPos.y == 1) {
-            return true;
-        }
-    }
-
-    // No target
-    return false;
+    return legal_actions(game, id).longTargets != 0;
 }
 
 /*
@@ -435,12 +566,12 @@ bool has_long_target(Game *game, int id) {
  * @param **argv    vector of argument values from cmdline
  */
 void startup_check(int argc, char **argv) {
-    int numPlayers, id, numCarriages;
+    int numPlayers, id, numCarriages, numLevels, numRounds;
     unsigned int seed;
     char *temp;
 
-    // Check we have enough args
-    if (argc < 5 || argc > 5) {
+    // Check we have enough args, levels and rounds come together if at all
+    if (argc != 5 && argc != 7) {
         handle_exit(WRONG_ARGS);
     }
 
@@ -467,6 +598,15 @@ void startup_check(int argc, char **argv) {
     if (!arg_is_number(argv[4]) || (seed = strtoul(argv[4], &temp, 10)) < 0) {
         handle_exit(INVALID_SEED);
     }
+
+    // Check levels and rounds
+    if (argc == 7 && (!arg_is_number(argv[5]) || !arg_is_number(argv[6])
+            || (numLevels = strtol(argv[5], &temp, 10)) < 1
+            || numLevels > MAX_LEVELS
+            || (numRounds = strtol(argv[6], &temp, 10)) < 1
+            || numRounds > MAX_ROUNDS)) {
+        handle_exit(INVALID_SHAPE);
+    }
 }
 
 /*
@@ -477,9 +617,14 @@ void startup_check(int argc, char **argv) {
  */
 void player_main(int argc, char **argv) {
     int myID, numPlayers, numCarriages;
+    int numLevels = DEFAULT_LEVELS, numRounds = DEFAULT_ROUNDS;
     unsigned int seed;
 
+    if (argc == 3 && strcmp(argv[1], CONNECT_FLAG) == 0) {
+        player_serve(argv[2]);
+    }
     startup_check(argc, argv);
+    log_init();
     // Send handshake/ready signal
     printf("!");
     fflush(stdout);
@@ -490,8 +635,77 @@ void player_main(int argc, char **argv) {
     numPlayers = strtol(argv[1], &temp, 10);
     numCarriages = strtol(argv[3], &temp, 10);
     seed = strtoul(argv[4], &temp, 10);
-    Game *game = make_game(numPlayers, numCarriages, seed);
+    if (argc == 7) {
+        numLevels = strtol(argv[5], &temp, 10);
+        numRounds = strtol(argv[6], &temp, 10);
+    }
+    Game *game = make_game(numPlayers, numCarriages, numLevels, numRounds,
+            seed);
 
     // run game
     player_game_loop(game, myID);
+    handle_exit(EXIT_SUCCESS);
+}
+
+/*
+ * Connects to a hub listening on a socket and plays each game it starts,
+ * until the hub hangs up.
+ *
+ * @param path      path of the hub's socket.
+ */
+void player_serve(char *path) {
+    char message[EXT_MSG_MAX_LEN];
+    int socket = connect_socket(path), id;
+    Game *game;
+
+    // Talk to the hub over the socket as if it were a pipe
+    if (socket == -1 || dup2(socket, STDIN_FILENO) == -1
+            || dup2(socket, STDOUT_FILENO) == -1 || close(socket) == -1) {
+        handle_exit(COMMS_ERROR);
+    }
+    log_init();
+    printf("!");
+    fflush(stdout);
+
+    // Setup is paid once, then games follow one another.
+    while (fgets(message, EXT_MSG_MAX_LEN, stdin) != NULL) {
+        if (message[strlen(message) - 1] == '\n') {
+            message[strlen(message) - 1] = '\0';
+        }
+        game = receive_new_game(message, &id);
+        player_game_loop(game, id);
+        free_game(game);
+    }
+    handle_exit(EXIT_SUCCESS);
+}
+
+/*
+ * Starts a game from a new game message sent to a connected player. The
+ * train's levels and the rounds follow the seed if they aren't the usual.
+ *
+ * @param message   the new game message.
+ * @param *id       where to store this player's id in the game.
+ * @return the player's view of the new game.
+ */
+Game *receive_new_game(char message[], int *id) {
+    int numPlayers, numCarriages, length = 0, extra = 0;
+    int numLevels = DEFAULT_LEVELS, numRounds = DEFAULT_ROUNDS;
+    unsigned int seed;
+    char *params = message + strlen(NEW_GAME);
+
+    if (!hub_message_valid(message)
+            || strncmp(message, NEW_GAME, strlen(NEW_GAME)) != 0
+            || sscanf(params, "%d,%d,%d,%u%n", &numPlayers, id,
+            &numCarriages, &seed, &length) != 4
+            || (params[length] != '\0' && (sscanf(params + length,
+            ",%d,%d%n", &numLevels, &numRounds, &extra) != 2
+            || params[length + extra] != '\0'))
+            || numPlayers < MIN_PLAYERS || numPlayers > MAX_PLAYERS
+            || *id < 0 || *id >= numPlayers
+            || numCarriages < MIN_CARRIAGES
+            || numLevels < 1 || numLevels > MAX_LEVELS
+            || numRounds < 1 || numRounds > MAX_ROUNDS) {
+        handle_exit(COMMS_ERROR);
+    }
+    return make_game(numPlayers, numCarriages, numLevels, numRounds, seed);
 }
@@ -17,6 +17,36 @@
 #define INVALID_WIDTH 4
 #define INVALID_SEED 5
 #define COMMS_ERROR 6
+#define INVALID_SHAPE 7
+
+/* Argument to connect to a hub's socket instead of being run by it */
+#define CONNECT_FLAG "--connect"
+
+/* Typedef Structs for readability */
+typedef struct PlayerAction Action;
+typedef struct ActionUndo Undo;
+
+/* An order with its direction or target, '\0' if it has none */
+struct PlayerAction {
+    char order;
+    char param;
+};
+
+/* What do_action changed, enough for undo_action to put it back */
+struct ActionUndo {
+    // The player acting and its last orders before acting.
+    int actor;
+    char orders[2];
+    // The one player whose position, loot or hits changed, the actor or
+    // its target, with its old position and the changes.
+    int id;
+    Position pos;
+    int loot;
+    int hits;
+    // The one spot on the train that changed, and by how much.
+    int cell;
+    int train;
+};
 
 /*
  * ===========================================================================
@@ -40,6 +70,24 @@ void startup_check(int argc, char **argv);
  */
 void player_main(int argc, char **argv);
 
+/*
+ * Connects to a hub listening on a socket and plays each game it starts,
+ * until the hub hangs up.
+ *
+ * @param path      path of the hub's socket.
+ */
+void player_serve(char *path);
+
+/*
+ * Starts a game from a new game message sent to a connected player. The
+ * train's levels and the rounds follow the seed if they aren't the usual.
+ *
+ * @param message   the new game message.
+ * @param *id       where to store this player's id in the game.
+ * @return the player's view of the new game.
+ */
+Game *receive_new_game(char message[], int *id);
+
 /*
  * ===========================================================================
  * Player Game Functions
@@ -80,6 +128,36 @@ void update_loot(Game *game, int player);
  */
 void update_move(Game *game, int player, char direction);
 
+/*
+ * Runs an action in place by the same rules as the update functions,
+ * without logging, and records how to take it back. For strategies that
+ * search ahead without copying the game.
+ *
+ * @param *game     the game being searched.
+ * @param player    the player acting.
+ * @param action    the action, which must be legal.
+ * @param *undo     where to record what changed.
+ */
+void do_action(Game *game, int player, Action action, Undo *undo);
+
+/*
+ * Takes back an action run by do_action, leaving the game and its hash
+ * exactly as they were. Actions must be undone in reverse order.
+ *
+ * @param *game     the game being searched.
+ * @param *undo     what do_action recorded.
+ */
+void undo_action(Game *game, Undo *undo);
+
+/*
+ * Applies a state message from the hub, setting the round and then each
+ * player and train spot listed.
+ *
+ * @param *game     the player's view of the game state.
+ * @param message   the state message sent by the hub.
+ */
+void apply_state(Game *game, char message[]);
+
 /*
  * Updates the state of the game for the players, based on
  * declared action by hub in execute phase.
@@ -118,12 +196,23 @@ void action_message(Game *game, char message[], int id);
 
 /*
  * Main player game loop to receive and handle messages.
+ * Returns once the hub says the game is over.
  *
  * @param *game     game struct with player view of game state
  * @param id        the id of this player
  */
 void player_game_loop(Game *game, int id);
 
+/*
+ * Gets the legal actions of a player, using those the hub sent with
+ * 'yourturn' when there are some.
+ *
+ * @param *game     current game state
+ * @param id        the player acting
+ * @return the player's legal actions.
+ */
+Legal legal_actions(Game *game, int id);
+
 /*
  * Checks if another player is in the same carriage as player.
  *
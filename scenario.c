@@ -0,0 +1,309 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include "scenario.h"
+#include "output.h"
+
+/*
+ * ===========================================================================
+ * CSSE2310 Assignment 3
+ * SCENARIO - Loading hand made loot layouts and starting positions
+ * ===========================================================================
+ */
+
+/* Function prototypes local to scenario */
+bool is_binary(FILE *file);
+bool read_word(FILE *file, char word[]);
+bool read_number(FILE *file, int *value);
+bool read_text_shape(FILE *file, int shape[], char word[]);
+bool read_binary_shape(FILE *file, int shape[], int *numPlaced);
+bool place_player(Game *game, int id, int x, int y);
+bool set_loot(Game *game, int x, int y, int loot);
+bool load_text(Game *game, FILE *file);
+bool load_binary(Game *game, FILE *file);
+
+/*
+ * Checks if a scenario is binary by its magic. Text scenarios are read
+ * again from the start.
+ *
+ * @param file      the scenario, just opened.
+ * @return true if binary, false if text.
+ */
+bool is_binary(FILE *file) {
+    char magic[strlen(SCENARIO_MAGIC)];
+
+    if (fread(magic, 1, sizeof(magic), file) == sizeof(magic)
+            && memcmp(magic, SCENARIO_MAGIC, sizeof(magic)) == 0) {
+        return true;
+    }
+    rewind(file);
+    return false;
+}
+
+/*
+ * Reads the next word of a text scenario, skipping comments.
+ *
+ * @param file      the scenario.
+ * @param word      buffer of SCENARIO_WORD_LEN for the word. Longer words
+ *                  are read in parts.
+ * @return true if a word was read, false at the end of the file.
+ */
+bool read_word(FILE *file, char word[]) {
+    int next, length = 0;
+
+    while ((next = fgetc(file)) != EOF) {
+        if (next == SCENARIO_COMMENT) {
+            while ((next = fgetc(file)) != EOF && next != '\n') {
+            }
+        } else if (!isspace(next)) {
+            break;
+        }
+    }
+    while (next != EOF && !isspace(next) && next != SCENARIO_COMMENT
+            && length < SCENARIO_WORD_LEN - 1) {
+        word[length++] = next;
+        next = fgetc(file);
+    }
+    if (next != EOF) {
+        ungetc(next, file);
+    }
+    word[length] = '\0';
+    return length > 0;
+}
+
+/*
+ * Reads the next word of a text scenario as a number that isn't negative.
+ *
+ * @param file      the scenario.
+ * @param *value    where to store the number.
+ * @return true if a number was read, false otherwise.
+ */
+bool read_number(FILE *file, int *value) {
+    char word[SCENARIO_WORD_LEN];
+
+    if (!read_word(file, word) || !arg_is_number(word)) {
+        return false;
+    }
+    *value = atoi(word);
+    return true;
+}
+
+/*
+ * Reads the shape at the start of a text scenario.
+ *
+ * @param file      the scenario, at its start.
+ * @param shape     where to store the carriages, levels and rounds.
+ * @param word      buffer of SCENARIO_WORD_LEN, left holding the first
+ *                  word after the shape, empty at the end of the file.
+ * @return true if the shape is valid, false otherwise.
+ */
+bool read_text_shape(FILE *file, int shape[], char word[]) {
+    char *names[] = {SCENARIO_CARRIAGES, SCENARIO_LEVELS, SCENARIO_ROUNDS};
+    int i;
+
+    shape[0] = 0;
+    shape[1] = DEFAULT_LEVELS;
+    shape[2] = DEFAULT_ROUNDS;
+    while (read_word(file, word)) {
+        for (i = 0; i < 3 && strcmp(word, names[i]) != 0; i++) {
+        }
+        if (i == 3) {
+            break;
+        } else if (!read_number(file, &shape[i])) {
+            return false;
+        }
+        word[0] = '\0';
+    }
+    return shape[0] >= MIN_CARRIAGES && shape[1] >= 1
+            && shape[1] <= MAX_LEVELS && shape[2] >= 1
+            && shape[2] <= MAX_ROUNDS;
+}
+
+/*
+ * Reads the header of a binary scenario, after its magic.
+ *
+ * @param file          the scenario, after the magic.
+ * @param shape         where to store the carriages, levels and rounds.
+ * @param *numPlaced    where to store how many players are placed.
+ * @return true if the header is valid, false otherwise.
+ */
+bool read_binary_shape(FILE *file, int shape[], int *numPlaced) {
+    uint32_t values[5];
+
+    for (int i = 0; i < 5; i++) {
+        if (!get_u32(file, &values[i])) {
+            return false;
+        }
+    }
+    shape[0] = values[1];
+    shape[1] = values[2];
+    shape[2] = values[3];
+    *numPlaced = values[4];
+    return values[0] == SCENARIO_VERSION && values[1] >= MIN_CARRIAGES
+            && values[1] <= INT32_MAX && values[2] >= 1
+            && values[2] <= MAX_LEVELS && values[3] >= 1
+            && values[3] <= MAX_ROUNDS && values[4] <= MAX_PLAYERS;
+}
+
+/*
+ * Reads the size of the train and the rounds of a scenario, so a game of
+ * the right shape can be made for it.
+ *
+ * @param path              the scenario file.
+ * @param *numCarriages     where to store the number of carriages.
+ * @param *numLevels        where to store the number of levels.
+ * @param *numRounds        where to store the number of rounds.
+ * @return true if the scenario's shape is valid, false otherwise.
+ */
+bool scenario_shape(char *path, int *numCarriages, int *numLevels,
+        int *numRounds) {
+    char word[SCENARIO_WORD_LEN];
+    int shape[3], numPlaced;
+    bool valid;
+    FILE *file;
+
+    if ((file = fopen(path, "rb")) == NULL) {
+        return false;
+    }
+    valid = is_binary(file) ? read_binary_shape(file, shape, &numPlaced)
+            : read_text_shape(file, shape, word);
+    fclose(file);
+
+    *numCarriages = shape[0];
+    *numLevels = shape[1];
+    *numRounds = shape[2];
+    return valid;
+}
+
+/*
+ * Moves a player to where a scenario places it.
+ *
+ * @param *game     the game being set up.
+ * @param id        the player.
+ * @param x         its carriage.
+ * @param y         its level.
+ * @return true if the player and spot exist, false otherwise.
+ */
+bool place_player(Game *game, int id, int x, int y) {
+    if (id < 0 || id >= game->numPlayers || x < 0
+            || x >= game->numCarriages || y < 0 || y >= game->numLevels) {
+        return false;
+    }
+    move_player(game, id, x, y);
+    return true;
+}
+
+/*
+ * Sets the loot in a spot on the train.
+ *
+ * @param *game     the game being set up.
+ * @param x         the carriage.
+ * @param y         the level.
+ * @param loot      loot in the spot.
+ * @return true if the spot exists, false otherwise.
+ */
+bool set_loot(Game *game, int x, int y, int loot) {
+    int index = train_index(game, x, y);
+
+    if (x < 0 || x >= game->numCarriages || y < 0 || y >= game->numLevels
+            || loot < 0) {
+        return false;
+    }
+    change_train(game, index, loot - game->train[index]);
+    return true;
+}
+
+/*
+ * Sets up a game from the entries of a text scenario.
+ *
+ * @param *game     the game being set up, with an empty train.
+ * @param file      the scenario, at its start.
+ * @return true if every entry is valid, false otherwise.
+ */
+bool load_text(Game *game, FILE *file) {
+    char word[SCENARIO_WORD_LEN];
+    int shape[3], x, y, loot;
+    bool valid;
+
+    valid = read_text_shape(file, shape, word)
+            && shape[0] == game->numCarriages && shape[1] == game->numLevels
+            && shape[2] == game->numRounds;
+    while (valid && word[0] != '\0') {
+        if (strcmp(word, SCENARIO_PLAYER) == 0) {
+            valid = read_word(file, word) && strlen(word) == 1
+                    && read_number(file, &x) && read_number(file, &y)
+                    && place_player(game, word[0] - 'A', x, y);
+        } else if (strcmp(word, SCENARIO_LOOT) == 0) {
+            valid = read_number(file, &x) && read_number(file, &y)
+                    && read_number(file, &loot) && set_loot(game, x, y, loot);
+        } else if (strcmp(word, SCENARIO_ROW) == 0) {
+            valid = read_number(file, &y) && y < game->numLevels;
+            for (x = 0; valid && x < game->numCarriages; x++) {
+                valid = read_number(file, &loot) && set_loot(game, x, y, loot);
+            }
+        } else {
+            valid = false;
+        }
+        if (valid && !read_word(file, word)) {
+            word[0] = '\0';
+        }
+    }
+    return valid;
+}
+
+/*
+ * Sets up a game from a binary scenario.
+ *
+ * @param *game     the game being set up, with an empty train.
+ * @param file      the scenario, after the magic.
+ * @return true if the scenario is whole, false otherwise.
+ */
+bool load_binary(Game *game, FILE *file) {
+    int shape[3], numPlaced;
+    uint32_t x, y, loot;
+    bool valid;
+
+    valid = read_binary_shape(file, shape, &numPlaced)
+            && shape[0] == game->numCarriages && shape[1] == game->numLevels
+            && shape[2] == game->numRounds && numPlaced <= game->numPlayers;
+    for (int i = 0; valid && i < numPlaced; i++) {
+        valid = get_u32(file, &x) && get_u32(file, &y)
+                && place_player(game, i, x, y);
+    }
+    // Loot comes in the order the train keeps it
+    for (int i = 0; valid && i < train_size(game); i++) {
+        valid = get_u32(file, &loot) && loot <= INT32_MAX;
+        if (valid) {
+            change_train(game, i, loot);
+        }
+    }
+    return valid;
+}
+
+/*
+ * Sets up a game as a scenario describes. The file is read as it goes,
+ * so the train is never held twice however wide it is.
+ *
+ * @param *game     game made with make_game in the scenario's shape.
+ * @param path      the scenario file.
+ * @return true if the scenario was loaded, false if it is invalid.
+ */
+bool load_scenario(Game *game, char *path) {
+    bool valid;
+    FILE *file;
+
+    if ((file = fopen(path, "rb")) == NULL) {
+        return false;
+    }
+
+    // Loot from the seed is replaced, not added to
+    for (int i = 0; i < train_size(game); i++) {
+        change_train(game, i, -game->train[i]);
+    }
+    valid = is_binary(file) ? load_binary(game, file)
+            : load_text(game, file);
+    fclose(file);
+    return valid;
+}
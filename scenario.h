@@ -0,0 +1,72 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "shared.h"
+
+/*
+ * ===========================================================================
+ * Scenario header file - loading hand made loot layouts and starting
+ * positions instead of those made from the seed.
+ * ===========================================================================
+ */
+
+/*
+ * Binary scenario layout, all values little endian u32 unless noted:
+ *  magic "TLSC" (4 bytes), version, carriages, levels, rounds, players,
+ *  then x and y of each player placed, then loot in each carriage on
+ *  each level in turn, lowest first.
+ */
+#define SCENARIO_MAGIC "TLSC"
+#define SCENARIO_VERSION 1
+
+/*
+ * Text scenarios are whitespace separated, with '#' starting a comment
+ * that runs to the end of the line. The shape comes first, carriages is
+ * needed and the others default to the usual:
+ *  carriages N, levels N, rounds N
+ * then any of:
+ *  player A x y    place a player
+ *  loot x y N      put N loot in a spot
+ *  row y N N ...   set the loot of every carriage on a level
+ * Spots that are never given loot are empty.
+ */
+#define SCENARIO_CARRIAGES "carriages"
+#define SCENARIO_LEVELS "levels"
+#define SCENARIO_ROUNDS "rounds"
+#define SCENARIO_PLAYER "player"
+#define SCENARIO_LOOT "loot"
+#define SCENARIO_ROW "row"
+#define SCENARIO_COMMENT '#'
+#define SCENARIO_WORD_LEN 16
+
+/*
+ * ===========================================================================
+ * Scenario functions
+ * ===========================================================================
+ */
+/*
+ * Reads the size of the train and the rounds of a scenario, so a game of
+ * the right shape can be made for it.
+ *
+ * @param path              the scenario file.
+ * @param *numCarriages     where to store the number of carriages.
+ * @param *numLevels        where to store the number of levels.
+ * @param *numRounds        where to store the number of rounds.
+ * @return true if the scenario's shape is valid, false otherwise.
+ */
+bool scenario_shape(char *path, int *numCarriages, int *numLevels,
+        int *numRounds);
+
+/*
+ * Sets up a game as a scenario describes. The file is read as it goes,
+ * so the train is never held twice however wide it is.
+ *
+ * @param *game     game made with make_game in the scenario's shape.
+ * @param path      the scenario file.
+ * @return true if the scenario was loaded, false if it is invalid.
+ */
+bool load_scenario(Game *game, char *path);
+
+#endif
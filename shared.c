@@ -61,25 +61,31 @@ int num_digits(int num) {
  *
  * @param numPlayers    number of players for this game.
  * @param numCarriages  max number of carriages for this game.
+ * @param numLevels     levels of the train, DEFAULT_LEVELS usually.
+ * @param numRounds     rounds in the game, DEFAULT_ROUNDS usually.
  * @param seed          game seed for setup.
  * @returns pointer to game, setup with players.
  */
-Game *make_game(int numPlayers, int numCarriages, unsigned int seed) {
+Game *make_game(int numPlayers, int numCarriages, int numLevels,
+        int numRounds, unsigned int seed) {
     Game *game = (Game *) malloc(sizeof(Game));
     game->players = (Player **) malloc(sizeof(Player *) * numPlayers);
-    for (int i = 0; i < numPlayers; i++) {
-        game->players[i] = (Player *) malloc(sizeof(Player) * numPlayers);
-    }
 
     // Setup parameters
     game->numPlayers = numPlayers;
     game->numCarriages = numCarriages;
+    game->numLevels = numLevels;
+    game->numRounds = numRounds;
     game->seed = seed;
     game->execute = false;
     game->round = 1;
+    game->legalFor = -1;
 
     // Setup Train, 2D array of carriages.
-    game->train = (int *) malloc(sizeof(int) * game->numCarriages * 2);
+    game->train = (int *) calloc(train_size(game), sizeof(int));
+    game->lootWords = (numCarriages + LOOT_WORD_BITS - 1) / LOOT_WORD_BITS;
+    game->lootBits = (uint64_t *) calloc(numLevels * game->lootWords,
+            sizeof(uint64_t));
 
     // Allocate loot
     int totalLoot = ((game->seed % 4) + 1) * game->numCarriages;
@@ -89,11 +95,11 @@ Game *make_game(int numPlayers, int numCarriages, unsigned int seed) {
         if (i == 0) {
             lootX = (int) ceil((float) numCarriages / 2);
             lootY = 0;
-            game->train[lootY * numCarriages + lootX]++;
+            game->train[train_index(game, lootX, lootY)]++;
         } else {
             lootX = (lootX + (game->seed % 101)) % numCarriages;
-            lootY = (lootY + (game->seed % 2)) % 2;
-            game->train[lootY * numCarriages + lootX]++;
+            lootY = (lootY + (game->seed % numLevels)) % numLevels;
+            game->train[train_index(game, lootX, lootY)]++;
         }
     }
 
@@ -101,10 +107,27 @@ Game *make_game(int numPlayers, int numCarriages, unsigned int seed) {
     for (int i = 0; i < game->numPlayers; i++) {
         game->players[i] = make_player(game, i);
     }
+    game->hash = hash_game(game);
+    index_loot(game);
 
     return game;
 }
 
+/*
+ * Frees a game and its players.
+ *
+ * @param *game     game made by make_game.
+ */
+void free_game(Game *game) {
+    for (int i = 0; i < game->numPlayers; i++) {
+        free(game->players[i]);
+    }
+    free(game->players);
+    free(game->train);
+    free(game->lootBits);
+    free(game);
+}
+
 /*
  * Sets up player information struct for storing in game struct.
  *
@@ -126,6 +149,279 @@ Player *make_player(Game *game, int thisID) {
     // Player starting status
     player->hits = 0;
     player->loot = 0;
+    memset(player->orders, '\0', sizeof(player->orders));
+    memset(player->newOrders, '\0', sizeof(player->newOrders));
+    player->policy = NO_POLICY;
+    player->plan.lastRound = 0;
+    player->plan.numRules = 0;
+
+    // Not seated until the hub starts or accepts the player
+    player->pid = 0;
+    player->input = NULL;
+    player->output = NULL;
 
     return player;
 }
+
+/*
+ * ===========================================================================
+ * Shared train layout functions
+ * ===========================================================================
+ */
+/*
+ * Gets the spot on the train of a carriage and level.
+ *
+ * @param *game     the game the train belongs to.
+ * @param x         the carriage.
+ * @param y         the level.
+ * @return index into the train.
+ */
+int train_index(Game *game, int x, int y) {
+    return y * game->numCarriages + x;
+}
+
+/*
+ * Gets the number of spots on the train.
+ *
+ * @param *game     the game the train belongs to.
+ * @return length of the train array.
+ */
+int train_size(Game *game) {
+    return game->numLevels * game->numCarriages;
+}
+
+/*
+ * Gets the level a vertical move goes to, the one above or the bottom
+ * one from the top. With two levels this goes between them.
+ *
+ * @param *game     the game being played.
+ * @param level     the level moved from.
+ * @return the level moved to.
+ */
+int next_level(Game *game, int level) {
+    return (level + 1) % game->numLevels;
+}
+
+/*
+ * Gets how many carriages away a long shot from a level can hit.
+ *
+ * @param *game     the game being played.
+ * @param level     the level the shot is taken from.
+ * @return INSIDE_RANGE inside the carriages, the length of the train on
+ *         the roofs.
+ */
+int long_range(Game *game, int level) {
+    return level == 0 ? INSIDE_RANGE : game->numCarriages;
+}
+
+/*
+ * Finds the nearest carriage past a carriage with loot on a level, by
+ * scanning the loot bits a word at a time.
+ *
+ * @param *game     the game being played.
+ * @param x         the carriage to look from, not itself looked at.
+ * @param y         the level to look on.
+ * @param step      -1 to look left, 1 to look right.
+ * @return the carriage found, -1 if there is no loot that way.
+ */
+int next_loot(Game *game, int x, int y, int step) {
+    uint64_t *bits = game->lootBits + y * game->lootWords, word;
+    int from = x + step, at;
+
+    if (from < 0 || from >= game->numCarriages) {
+        return -1;
+    }
+    at = from / LOOT_WORD_BITS;
+    // Drop the carriages behind the one looked from in its word
+    if (step > 0) {
+        word = bits[at] & (~0ULL << (from % LOOT_WORD_BITS));
+    } else {
+        word = bits[at] & (~0ULL >> (LOOT_WORD_BITS - 1
+                - from % LOOT_WORD_BITS));
+    }
+    while (word == 0) {
+        at += step;
+        if (at < 0 || at >= game->lootWords) {
+            return -1;
+        }
+        word = bits[at];
+    }
+    return at * LOOT_WORD_BITS + (step > 0 ? __builtin_ctzll(word)
+            : LOOT_WORD_BITS - 1 - __builtin_clzll(word));
+}
+
+/*
+ * Finds the nearest spot with loot to a carriage on any level, counting
+ * carriages only, so loot in the carriage itself is nearest of all. Ties
+ * go to the left, then to the lowest level.
+ *
+ * @param *game     the game being played.
+ * @param x         the carriage to look from.
+ * @param *level    where to store the level of the spot found.
+ * @return the carriage found, -1 if the train has no loot left.
+ */
+int nearest_loot(Game *game, int x, int *level) {
+    int best = -1, found;
+
+    for (int y = 0; y < game->numLevels; y++) {
+        if (game->train[train_index(game, x, y)] > 0) {
+            *level = y;
+            return x;
+        }
+    }
+    for (int y = 0; y < game->numLevels; y++) {
+        for (int step = -1; step <= 1; step += 2) {
+            found = next_loot(game, x, y, step);
+            if (found != -1 && (best == -1 || abs(found - x) < abs(best - x)
+                    || (abs(found - x) == abs(best - x) && found < best))) {
+                best = found;
+                *level = y;
+            }
+        }
+    }
+    return best;
+}
+
+/*
+ * ===========================================================================
+ * Shared state changing functions, these keep the game hash up to date.
+ * ===========================================================================
+ */
+/*
+ * Gets the hash contribution of part of the game holding a value.
+ * Parts holding zero contribute nothing.
+ *
+ * @param feature   which part of the game, see FEATURE_ constants.
+ * @param value     the value that part holds.
+ * @return 64 bit key for that part holding that value.
+ */
+uint64_t state_key(uint64_t feature, uint64_t value) {
+    // splitmix64 finaliser, stands in for a table of random keys.
+    uint64_t key = (feature << 32) ^ value;
+    if (value == 0) {
+        return 0;
+    }
+    key += 0x9E3779B97F4A7C15ULL;
+    key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+    return key ^ (key >> 31);
+}
+
+/*
+ * Hashes the whole game from scratch.
+ *
+ * @param *game     game state to hash.
+ * @return the Zobrist hash of the game.
+ */
+uint64_t hash_game(Game *game) {
+    uint64_t hash = 0, feature;
+    Player *player;
+
+    for (int i = 0; i < game->numPlayers; i++) {
+        player = game->players[i];
+        feature = i * PLAYER_FEATURES;
+        hash ^= state_key(feature + FEATURE_X, player->pos.x);
+        hash ^= state_key(feature + FEATURE_Y, player->pos.y);
+        hash ^= state_key(feature + FEATURE_LOOT, player->loot);
+        hash ^= state_key(feature + FEATURE_HITS, player->hits);
+    }
+    for (int i = 0; i < train_size(game); i++) {
+        hash ^= state_key(FEATURE_TRAIN + i, game->train[i]);
+    }
+    return hash;
+}
+
+/*
+ * Sets the loot bits from the train, after it is written directly.
+ *
+ * @param *game     game state to index.
+ */
+void index_loot(Game *game) {
+    int bit;
+
+    memset(game->lootBits, 0, sizeof(uint64_t) * game->numLevels
+            * game->lootWords);
+    for (int y = 0; y < game->numLevels; y++) {
+        for (int x = 0; x < game->numCarriages; x++) {
+            if (game->train[train_index(game, x, y)] > 0) {
+                bit = y * game->lootWords * LOOT_WORD_BITS + x;
+                game->lootBits[bit / LOOT_WORD_BITS] |=
+                        1ULL << (bit % LOOT_WORD_BITS);
+            }
+        }
+    }
+}
+
+/*
+ * Moves a player to a new position.
+ *
+ * @param *game     game state to change.
+ * @param id        the player moving.
+ * @param x         new carriage of the player.
+ * @param y         new level of the player.
+ */
+void move_player(Game *game, int id, int x, int y) {
+    Position *pos = &game->players[id]->pos;
+    uint64_t feature = id * PLAYER_FEATURES;
+
+    game->hash ^= state_key(feature + FEATURE_X, pos->x)
+            ^ state_key(feature + FEATURE_X, x)
+            ^ state_key(feature + FEATURE_Y, pos->y)
+            ^ state_key(feature + FEATURE_Y, y);
+    pos->x = x;
+    pos->y = y;
+}
+
+/*
+ * Changes the loot held by a player.
+ *
+ * @param *game     game state to change.
+ * @param id        the player whose loot changes.
+ * @param delta     amount of loot gained, negative if lost.
+ */
+void change_loot(Game *game, int id, int delta) {
+    int *loot = &game->players[id]->loot;
+    uint64_t feature = id * PLAYER_FEATURES + FEATURE_LOOT;
+
+    game->hash ^= state_key(feature, *loot) ^ state_key(feature,
+            *loot + delta);
+    *loot += delta;
+}
+
+/*
+ * Changes the hits taken by a player.
+ *
+ * @param *game     game state to change.
+ * @param id        the player whose hits change.
+ * @param delta     hits taken, negative if dried out.
+ */
+void change_hits(Game *game, int id, int delta) {
+    int *hits = &game->players[id]->hits;
+    uint64_t feature = id * PLAYER_FEATURES + FEATURE_HITS;
+
+    game->hash ^= state_key(feature, *hits) ^ state_key(feature,
+            *hits + delta);
+    *hits += delta;
+}
+
+/*
+ * Changes the loot left in a spot on the train.
+ *
+ * @param *game     game state to change.
+ * @param index     spot on the train, level * carriages + carriage.
+ * @param delta     loot added, negative if picked up.
+ */
+void change_train(Game *game, int index, int delta) {
+    int *loot = &game->train[index];
+    // Bit of the spot, each level's bits start on a new word
+    int bit = (index / game->numCarriages) * game->lootWords
+            * LOOT_WORD_BITS + index % game->numCarriages;
+
+    game->hash ^= state_key(FEATURE_TRAIN + index, *loot)
+            ^ state_key(FEATURE_TRAIN + index, *loot + delta);
+    // Spots only change bits when emptied or given their first loot
+    if ((*loot > 0) != (*loot + delta > 0)) {
+        game->lootBits[bit / LOOT_WORD_BITS] ^= 1ULL << (bit % LOOT_WORD_BITS);
+    }
+    *loot += delta;
+}
@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 /*
@@ -17,14 +18,38 @@
 
 /* Train Constraints */
 #define MIN_CARRIAGES 3
+/* Levels of the train, 0 inside the carriages and the roofs above */
+#define DEFAULT_LEVELS 2
+#define MAX_LEVELS 16
+/* Carriages a long shot carries inside, on a roof it carries the length
+ * of the train */
+#define INSIDE_RANGE 1
+/* Carriages covered by each word of a level's loot bits */
+#define LOOT_WORD_BITS 64
 
-/* Game Constants */
-#define MAX_ROUNDS 15
+/* Parts of the game that are hashed, per player then per train spot */
+#define FEATURE_X 0
+#define FEATURE_Y 1
+#define FEATURE_LOOT 2
+#define FEATURE_HITS 3
+#define PLAYER_FEATURES 4
+#define FEATURE_TRAIN (MAX_PLAYERS * PLAYER_FEATURES)
+
+/* Game Constants, round numbers must fit a u16 in binary output */
+#define DEFAULT_ROUNDS 15
+#define MAX_ROUNDS 65535
+#define PLAN_MAX_RULES 8
+
+/* Horizontal moves that may be legal, see Legal */
+#define LEGAL_LEFT 1
+#define LEGAL_RIGHT 2
 
 /* Typedef Structs for readability */
 typedef struct PlayerInfo Player;
 typedef struct GameInfo Game;
 typedef struct Posn Position;
+typedef struct PlanInfo Plan;
+typedef struct LegalActions Legal;
 
 /* Represents position of a player, where x = horizontal, y = vertical */
 struct Posn {
@@ -32,19 +57,49 @@ struct Posn {
     int y;
 };
 
+/* Decision list a player has left with the hub to order on its behalf */
+struct PlanInfo {
+    // Last round the plan covers, plan is spent once we are past it.
+    int lastRound;
+    int numRules;
+    // Each rule is a predicate, an order and a policy for that order.
+    char rules[PLAN_MAX_RULES][3];
+};
+
+/* Actions a player may take in the current state, bit i of a target set
+ * if player i may be shot. Other orders are always legal. */
+struct LegalActions {
+    // LEGAL_ flags of the moves off neither end of the train
+    unsigned int moves;
+    unsigned int shortTargets;
+    unsigned int longTargets;
+};
+
 /* Main Game Struct */
 struct GameInfo {
     // Base game params
     int numPlayers;
     unsigned int seed;
     int numCarriages;
+    int numLevels;
+    // Rounds in the game, the game is over once round is past this.
+    int numRounds;
     int round;
     // Game Phase, true if we are in execute phase.
     bool execute;
     // An array of player structs
     Player **players;
-    // The Train
+    // The Train, numLevels rows of numCarriages, see train_index.
     int *train;
+    // Zobrist hash of positions, loot, hits and train, kept up to date
+    // by the state changing functions.
+    uint64_t hash;
+    // Bit per spot set while it has loot, lootWords words per level in
+    // the order of the train, kept up to date with it, see next_loot.
+    uint64_t *lootBits;
+    int lootWords;
+    // Player whose legal actions were sent by the hub, -1 if none.
+    int legalFor;
 };
 
 /* Player Data */
@@ -58,8 +113,15 @@ struct PlayerInfo {
     int loot;
     // Player orders, index 0 == order type, index 1 == target/direction
     char orders[2];
-    // New orders for hub to track orders received.
+    // New orders for hub to track orders received, players keep the order
+    // types announced this round.
     char newOrders[2];
+    // Direction/target policy sent with the new order, if any.
+    char policy;
+    // Plan the hub follows instead of asking this player, if any.
+    Plan plan;
+    // Legal actions when this player's order is checked or chosen.
+    Legal legal;
     // Player ID
     pid_t pid;
     // Player pipe end file descriptors
@@ -78,10 +140,13 @@ struct PlayerInfo {
  *
  * @param numPlayers    number of players for this game.
  * @param numCarriages  max number of carriages for this game.
+ * @param numLevels     levels of the train, DEFAULT_LEVELS usually.
+ * @param numRounds     rounds in the game, DEFAULT_ROUNDS usually.
  * @param seed          game seed for setup.
  * @returns pointer to game, setup with players.
  */
-Game *make_game(int numPlayers, int numCarriages, unsigned int seed);
+Game *make_game(int numPlayers, int numCarriages, int numLevels,
+        int numRounds, unsigned int seed);
 
 /*
  * Sets up player information struct for storing in game struct.
@@ -94,6 +159,147 @@ Player *make_player(Game *game, int thisID);
 
 void free_structs();
 
+/*
+ * Frees a game and its players.
+ *
+ * @param *game     game made by make_game.
+ */
+void free_game(Game *game);
+
+/*
+ * ===========================================================================
+ * Common train layout functions
+ * ===========================================================================
+ */
+/*
+ * Gets the spot on the train of a carriage and level.
+ *
+ * @param *game     the game the train belongs to.
+ * @param x         the carriage.
+ * @param y         the level.
+ * @return index into the train.
+ */
+int train_index(Game *game, int x, int y);
+
+/*
+ * Gets the number of spots on the train.
+ *
+ * @param *game     the game the train belongs to.
+ * @return length of the train array.
+ */
+int train_size(Game *game);
+
+/*
+ * Gets the level a vertical move goes to, the one above or the bottom
+ * one from the top. With two levels this goes between them.
+ *
+ * @param *game     the game being played.
+ * @param level     the level moved from.
+ * @return the level moved to.
+ */
+int next_level(Game *game, int level);
+
+/*
+ * Gets how many carriages away a long shot from a level can hit.
+ *
+ * @param *game     the game being played.
+ * @param level     the level the shot is taken from.
+ * @return INSIDE_RANGE inside the carriages, the length of the train on
+ *         the roofs.
+ */
+int long_range(Game *game, int level);
+
+/*
+ * Finds the nearest carriage past a carriage with loot on a level, by
+ * scanning the loot bits a word at a time.
+ *
+ * @param *game     the game being played.
+ * @param x         the carriage to look from, not itself looked at.
+ * @param y         the level to look on.
+ * @param step      -1 to look left, 1 to look right.
+ * @return the carriage found, -1 if there is no loot that way.
+ */
+int next_loot(Game *game, int x, int y, int step);
+
+/*
+ * Finds the nearest spot with loot to a carriage on any level, counting
+ * carriages only, so loot in the carriage itself is nearest of all. Ties
+ * go to the left, then to the lowest level.
+ *
+ * @param *game     the game being played.
+ * @param x         the carriage to look from.
+ * @param *level    where to store the level of the spot found.
+ * @return the carriage found, -1 if the train has no loot left.
+ */
+int nearest_loot(Game *game, int x, int *level);
+
+/*
+ * ===========================================================================
+ * Common state changing functions, these keep the game hash up to date.
+ * ===========================================================================
+ */
+/*
+ * Moves a player to a new position.
+ *
+ * @param *game     game state to change.
+ * @param id        the player moving.
+ * @param x         new carriage of the player.
+ * @param y         new level of the player.
+ */
+void move_player(Game *game, int id, int x, int y);
+
+/*
+ * Changes the loot held by a player.
+ *
+ * @param *game     game state to change.
+ * @param id        the player whose loot changes.
+ * @param delta     amount of loot gained, negative if lost.
+ */
+void change_loot(Game *game, int id, int delta);
+
+/*
+ * Changes the hits taken by a player.
+ *
+ * @param *game     game state to change.
+ * @param id        the player whose hits change.
+ * @param delta     hits taken, negative if dried out.
+ */
+void change_hits(Game *game, int id, int delta);
+
+/*
+ * Changes the loot left in a spot on the train.
+ *
+ * @param *game     game state to change.
+ * @param index     spot on the train, level * carriages + carriage.
+ * @param delta     loot added, negative if picked up.
+ */
+void change_train(Game *game, int index, int delta);
+
+/*
+ * Gets the hash contribution of part of the game holding a value.
+ * Parts holding zero contribute nothing.
+ *
+ * @param feature   which part of the game, see FEATURE_ constants.
+ * @param value     the value that part holds.
+ * @return 64 bit key for that part holding that value.
+ */
+uint64_t state_key(uint64_t feature, uint64_t value);
+
+/*
+ * Hashes the whole game from scratch.
+ *
+ * @param *game     game state to hash.
+ * @return the Zobrist hash of the game.
+ */
+uint64_t hash_game(Game *game);
+
+/*
+ * Sets the loot bits from the train, after it is written directly.
+ *
+ * @param *game     game state to index.
+ */
+void index_loot(Game *game);
+
 /*
  * ===========================================================================
  * Common Utility/Admin functions
@@ -0,0 +1,519 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include "sim.h"
+#include "comms.h"
+#include "output.h"
+
+/*
+ * ===========================================================================
+ * CSSE2310 Assignment 3
+ * 2310sim - plays many games of the built in strategies side by side in
+ * one process, without starting players.
+ * ===========================================================================
+ */
+
+// Optional simulator modes
+SimOptions simOptions = DEFAULT_SIM_OPTIONS;
+
+/*
+ * Exits with a message for the exit status.
+ *
+ * @param exitStatus    one of the exit codes.
+ */
+void sim_exit(int exitStatus) {
+    switch (exitStatus) {
+        case WRONG_ARGS:
+            fprintf(stderr, "Usage: 2310sim [-n games] [-l] [-f format] "
+                    "seed width player player [player ...]\n");
+            break;
+        case INVALID_ARG:
+            fprintf(stderr, "Bad argument\n");
+            break;
+        case PACK_FAIL:
+            fprintf(stderr, "Game doesn't survive packing\n");
+            break;
+    }
+    exit(exitStatus);
+}
+
+/*
+ * Reads flags given before the seed into the simulator options.
+ *
+ * @param argc      count of arguments provided
+ * @param argv      array of pointers to arguments provided
+ * @return number of arguments consumed by flags.
+ */
+int parse_sim_options(int argc, char **argv) {
+    struct option longOptions[] = {
+        {"games", required_argument, NULL, 'n'},
+        {"list", no_argument, NULL, 'l'},
+        {"format", required_argument, NULL, 'f'},
+        {NULL, 0, NULL, 0}
+    };
+    int flag;
+
+    // Stop at the seed, and report bad flags as usage errors ourselves.
+    opterr = 0;
+    while ((flag = getopt_long(argc, argv, "+n:lf:", longOptions, NULL))
+            != -1) {
+        switch (flag) {
+            case 'n':
+                if (!arg_is_number(optarg)
+                        || (simOptions.games = atol(optarg)) < 1) {
+                    sim_exit(INVALID_ARG);
+                }
+                break;
+            case 'l':
+                simOptions.list = true;
+                break;
+            case 'f':
+                if ((simOptions.format = format_from_name(optarg)) == -1) {
+                    sim_exit(INVALID_ARG);
+                }
+                break;
+            default:
+                sim_exit(WRONG_ARGS);
+        }
+    }
+    return optind - 1;
+}
+
+/*
+ * Finds the strategy of a player program, by the program's name.
+ *
+ * @param path      path to the player program, e.g. ./bandit.
+ * @return one of the SIM_ strategies, or -1 if it can't be simulated.
+ */
+int strategy_from_path(char *path) {
+    char *names[] = SIM_STRATEGY_NAMES;
+    char *name = strrchr(path, '/');
+
+    name = name == NULL ? path : name + 1;
+    for (int i = 0; i < SIM_NUM_STRATEGIES; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Sets up a game in each lane, as make_game would for its seed.
+ *
+ * @param *batch    batch with its lineup and train width set.
+ * @param seed      seed of the first lane, later lanes count up from it.
+ * @param numLanes  lanes to use, at most SIM_LANES.
+ */
+void start_batch(Batch *batch, unsigned int seed, int numLanes) {
+    PackedGame packed, repacked;
+    uint64_t hash;
+    Game *game;
+
+    batch->numLanes = numLanes;
+    for (int lane = 0; lane < numLanes; lane++) {
+        // Loot is placed by the same code the hub uses
+        batch->seeds[lane] = seed + lane;
+        game = make_game(batch->numPlayers, batch->numCarriages,
+                DEFAULT_LEVELS, DEFAULT_ROUNDS, batch->seeds[lane]);
+        // Lanes are filled from a packed copy, so it must unpack to the
+        // same game and pack the same again
+        hash = game->hash;
+        if (!pack_game(game, &packed)) {
+            sim_exit(PACK_FAIL);
+        }
+        unpack_game(&packed, game);
+        if (game->hash != hash || !pack_game(game, &repacked)
+                || !packed_equal(&packed, &repacked)) {
+            sim_exit(PACK_FAIL);
+        }
+        for (int i = 0; i < batch->numPlayers; i++) {
+            batch->x[i][lane] = PACKED_X(packed.players[i]);
+            batch->y[i][lane] = PACKED_Y(packed.players[i]);
+            batch->loot[i][lane] = PACKED_LOOT(packed.players[i]);
+            batch->hits[i][lane] = PACKED_HITS(packed.players[i]);
+            batch->last[i][lane] = '\0';
+            batch->direction[i][lane] = '\0';
+        }
+        // Both are lower level first, packed at a fixed stride
+        for (int c = 0; c < batch->numCarriages; c++) {
+            batch->train[c][lane] = packed.train[c];
+            batch->train[batch->numCarriages + c][lane] =
+                    packed.train[PACKED_MAX_CARRIAGES + c];
+        }
+        free_game(game);
+    }
+}
+
+/*
+ * Looks around a player in every lane. Each loop runs over lanes with
+ * selects rather than branches, so it vectorises.
+ *
+ * @param *batch    the games.
+ * @param id        the player looking.
+ * @param *sight    where to store what it sees.
+ */
+SIM_CLONES
+void look_around(Batch *batch, int id, Sight *sight) {
+    int16_t leftX[SIM_LANES], rightX[SIM_LANES], left[SIM_LANES],
+            right[SIM_LANES], lootX[SIM_LANES], lootRightX[SIM_LANES];
+    int16_t *myX = batch->x[id], *myY = batch->y[id];
+    int width = batch->numCarriages, lanes = batch->numLanes;
+
+    for (int lane = 0; lane < lanes; lane++) {
+        sight->shortTarget[lane] = -1;
+        sight->longLowest[lane] = -1;
+        sight->otherLevel[lane] = 0;
+        sight->playersLeft[lane] = 0;
+        sight->playersRight[lane] = 0;
+        left[lane] = -1;
+        right[lane] = -1;
+        leftX[lane] = -1;
+        rightX[lane] = width;
+    }
+
+    // Other players, in id order as the players look at them
+    for (int i = 0; i < batch->numPlayers; i++) {
+        int16_t *x = batch->x[i], *y = batch->y[i];
+        if (i == id) {
+            continue;
+        }
+        for (int lane = 0; lane < lanes; lane++) {
+            int dx = x[lane] - myX[lane], level = y[lane] == myY[lane];
+            int inShort = level & (dx == 0);
+            int inLong = level & (dx != 0) & ((myY[lane] == 1)
+                    | (dx == 1) | (dx == -1));
+            int nearLeft = inLong & (dx < 0) & (x[lane] >= leftX[lane]);
+            int nearRight = inLong & (dx > 0) & (x[lane] <= rightX[lane]);
+
+            sight->shortTarget[lane] = inShort ? i : sight->shortTarget[lane];
+            sight->longLowest[lane] = inLong & (sight->longLowest[lane] < 0)
+                    ? i : sight->longLowest[lane];
+            left[lane] = nearLeft ? i : left[lane];
+            leftX[lane] = nearLeft ? x[lane] : leftX[lane];
+            right[lane] = nearRight ? i : right[lane];
+            rightX[lane] = nearRight ? x[lane] : rightX[lane];
+            sight->otherLevel[lane] |= !level & (dx == 0);
+            sight->playersLeft[lane] += dx < 0;
+            sight->playersRight[lane] += dx > 0;
+        }
+    }
+    for (int lane = 0; lane < lanes; lane++) {
+        sight->longNearest[lane] = left[lane] > right[lane] ? left[lane]
+                : right[lane];
+        sight->lootLeft[lane] = 0;
+        sight->lootRight[lane] = 0;
+        sight->lootLower[lane] = 0;
+        sight->lootUpper[lane] = 0;
+        lootX[lane] = -1;
+        lootRightX[lane] = width;
+    }
+
+    // Loot, a carriage at a time
+    for (int c = 0; c < width; c++) {
+        int16_t *lower = batch->train[c], *upper = batch->train[width + c];
+        for (int lane = 0; lane < lanes; lane++) {
+            int both = lower[lane] + upper[lane];
+            sight->lootLeft[lane] += c < myX[lane] ? both : 0;
+            sight->lootRight[lane] += c > myX[lane] ? both : 0;
+            sight->lootLower[lane] += lower[lane];
+            sight->lootUpper[lane] += upper[lane];
+            // Last carriage with loot up to here, first one past here
+            lootX[lane] = both > 0 && c <= myX[lane] ? c : lootX[lane];
+            lootRightX[lane] = both > 0 && c > myX[lane]
+                    && lootRightX[lane] == width ? c : lootRightX[lane];
+        }
+    }
+    for (int lane = 0; lane < lanes; lane++) {
+        // Carriages away on each side, width if there is no loot there
+        int toLeft = lootX[lane] >= 0 ? myX[lane] - lootX[lane] : width;
+        int toRight = lootRightX[lane] - myX[lane];
+        toRight = lootRightX[lane] < width ? toRight : width;
+
+        sight->lootHere[lane] = batch->train[myY[lane] * width
+                + myX[lane]][lane];
+        sight->lootNearest[lane] = toLeft == 0
+                || (toLeft == width && toRight == width) ? 0
+                : toLeft <= toRight ? -1 : 1;
+    }
+}
+
+/*
+ * Gives every player its order for the round, from the state at the
+ * start of the round, as the hub asks for them.
+ *
+ * @param *batch    the games.
+ */
+SIM_CLONES
+void order_round(Batch *batch) {
+    int lanes = batch->numLanes;
+    Sight sight;
+
+    for (int i = 0; i < batch->numPlayers; i++) {
+        int16_t *order = batch->order[i], *last = batch->last[i],
+                *y = batch->y[i], *hits = batch->hits[i];
+        look_around(batch, i, &sight);
+        // Strategy is the same in every lane, so pick it outside the loop
+        switch (batch->strategies[i]) {
+            case SIM_ACROPHOBE:
+                // Its plan: loot if there is loot, else keep moving
+                for (int lane = 0; lane < lanes; lane++) {
+                    order[lane] = sight.lootHere[lane] > 0 ? LOOT : MOVE_H;
+                }
+                break;
+            case SIM_BANDIT:
+                for (int lane = 0; lane < lanes; lane++) {
+                    int shotLast = last[lane] == SHOOT_S
+                            || last[lane] == SHOOT_L;
+                    int lower = sight.lootLower[lane],
+                            upper = sight.lootUpper[lane];
+                    order[lane] = sight.lootHere[lane] > 0 ? LOOT
+                            : !shotLast && sight.shortTarget[lane] >= 0
+                            ? SHOOT_S
+                            : lower != upper && (upper > lower) != y[lane]
+                            ? MOVE_V
+                            : sight.lootLeft[lane] != sight.lootRight[lane]
+                            ? MOVE_H
+                            : sight.longLowest[lane] >= 0 ? SHOOT_L
+                            : MOVE_V;
+                }
+                break;
+            case SIM_SPOILER:
+                for (int lane = 0; lane < lanes; lane++) {
+                    int shotLast = last[lane] == SHOOT_S
+                            || last[lane] == SHOOT_L;
+                    order[lane] = !shotLast && sight.shortTarget[lane] >= 0
+                            ? SHOOT_S
+                            : !shotLast && sight.longLowest[lane] >= 0
+                            ? SHOOT_L
+                            : sight.otherLevel[lane] ? MOVE_V
+                            : sight.lootHere[lane] > 0 ? LOOT : MOVE_H;
+                }
+                break;
+        }
+        // Players with three hits aren't asked
+        for (int lane = 0; lane < lanes; lane++) {
+            order[lane] = hits[lane] >= 3 ? DRY : order[lane];
+        }
+    }
+}
+
+/*
+ * Runs one player's order in every lane, choosing its direction or target
+ * as the player or hub would once it is run.
+ *
+ * @param *batch    the games.
+ * @param id        the player whose order is run.
+ */
+SIM_CLONES
+void run_orders(Batch *batch, int id) {
+    int16_t *order = batch->order[id], *x = batch->x[id], *y = batch->y[id];
+    int16_t *direction = batch->direction[id];
+    int width = batch->numCarriages, strategy = batch->strategies[id];
+    int16_t *targets;
+    Sight sight;
+
+    look_around(batch, id, &sight);
+    // Only the bandit and spoiler shoot long, acrophobes shoot no one.
+    targets = strategy == SIM_BANDIT ? sight.longLowest : sight.longNearest;
+
+    for (int lane = 0; lane < batch->numLanes; lane++) {
+        int cell = y[lane] * width + x[lane], target, step;
+        switch (order[lane]) {
+            case DRY:
+                batch->hits[id][lane] = 0;
+                break;
+            case LOOT:
+                if (batch->train[cell][lane] > 0) {
+                    batch->train[cell][lane]--;
+                    batch->loot[id][lane]++;
+                }
+                break;
+            case SHOOT_S:
+                // Short targets share the shooter's spot
+                target = sight.shortTarget[lane];
+                if (target >= 0 && batch->loot[target][lane] > 0) {
+                    batch->loot[target][lane]--;
+                    batch->train[cell][lane]++;
+                }
+                break;
+            case SHOOT_L:
+                target = strategy == SIM_ACROPHOBE ? -1 : targets[lane];
+                if (target >= 0) {
+                    batch->hits[target][lane]++;
+                }
+                break;
+            case MOVE_V:
+                y[lane] = 1 - y[lane];
+                break;
+            case MOVE_H:
+                if (strategy == SIM_ACROPHOBE) {
+                    // Hub keeps its direction, turning at the ends
+                    step = direction[lane] == DIR_LEFT && x[lane] > 0 ? -1
+                            : direction[lane] == DIR_RIGHT
+                            && x[lane] < width - 1 ? 1 : 0;
+                } else if (strategy == SIM_BANDIT) {
+                    step = sight.lootLeft[lane] > sight.lootRight[lane] ? -1
+                            : sight.lootRight[lane] > sight.lootLeft[lane]
+                            ? 1 : sight.lootNearest[lane];
+                } else {
+                    step = sight.playersLeft[lane] > sight.playersRight[lane]
+                            ? -1 : sight.playersRight[lane]
+                            > sight.playersLeft[lane] ? 1 : 0;
+                }
+                if (step == 0) {
+                    step = x[lane] == 0 ? 1 : -1;
+                }
+                x[lane] += step;
+                direction[lane] = step < 0 ? DIR_LEFT : DIR_RIGHT;
+                break;
+        }
+        batch->last[id][lane] = order[lane];
+    }
+}
+
+/*
+ * Plays every round of the games in a batch.
+ *
+ * @param *batch    the games, as set up by start_batch.
+ */
+void play_batch(Batch *batch) {
+    for (int round = 0; round < DEFAULT_ROUNDS; round++) {
+        order_round(batch);
+        for (int i = 0; i < batch->numPlayers; i++) {
+            run_orders(batch, i);
+        }
+    }
+}
+
+/*
+ * Copies the state of one lane into a game of the same size.
+ *
+ * @param *batch    the games.
+ * @param lane      the lane to copy.
+ * @param *game     game made with make_game for the same players and
+ *                  carriages.
+ */
+void lane_game(Batch *batch, int lane, Game *game) {
+    Player *player;
+
+    game->seed = batch->seeds[lane];
+    game->round = DEFAULT_ROUNDS + 1;
+    for (int i = 0; i < batch->numPlayers; i++) {
+        player = game->players[i];
+        player->pos.x = batch->x[i][lane];
+        player->pos.y = batch->y[i][lane];
+        player->loot = batch->loot[i][lane];
+        player->hits = batch->hits[i][lane];
+        player->orders[0] = batch->last[i][lane];
+        player->orders[1] = batch->direction[i][lane];
+    }
+    for (int i = 0; i < batch->numCarriages * 2; i++) {
+        game->train[i] = batch->train[i][lane];
+    }
+    game->hash = hash_game(game);
+    index_loot(game);
+}
+
+/*
+ * Finds the winners of one lane, everyone with the most loot.
+ *
+ * @param *batch    the games.
+ * @param lane      the lane whose game is over.
+ * @param winners   where to store the winners' symbols.
+ * @return how many players won.
+ */
+int lane_winners(Batch *batch, int lane, char winners[]) {
+    int mostLoot = 0, numWinners = 0;
+
+    for (int i = 0; i < batch->numPlayers; i++) {
+        if (batch->loot[i][lane] > mostLoot) {
+            mostLoot = batch->loot[i][lane];
+        }
+    }
+    for (int i = 0; i < batch->numPlayers; i++) {
+        if (batch->loot[i][lane] == mostLoot) {
+            winners[numWinners++] = 'A' + i;
+        }
+    }
+    return numWinners;
+}
+
+int main(int argc, char **argv) {
+    char *names[] = SIM_STRATEGY_NAMES, winners[MAX_PLAYERS];
+    long wins[MAX_PLAYERS] = {0}, loot[MAX_PLAYERS] = {0};
+    Batch *batch = (Batch *) calloc(1, sizeof(Batch));
+    struct timespec start, end;
+    int numWinners, lanes;
+    unsigned int seed;
+    Game *game;
+
+    setvbuf(stdout, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+    int flags = parse_sim_options(argc, argv);
+    argc -= flags;
+    argv += flags;
+
+    // Same positional arguments as the hub
+    if (argc < 3 + MIN_PLAYERS) {
+        sim_exit(WRONG_ARGS);
+    }
+    if (!arg_is_number(argv[1]) || !arg_is_number(argv[2])) {
+        sim_exit(INVALID_ARG);
+    }
+    seed = strtoul(argv[1], NULL, 10);
+    batch->numCarriages = atoi(argv[2]);
+    batch->numPlayers = argc - 3;
+    if (batch->numPlayers > MAX_PLAYERS
+            || batch->numCarriages < MIN_CARRIAGES
+            || batch->numCarriages > SIM_MAX_CARRIAGES) {
+        sim_exit(INVALID_ARG);
+    }
+    for (int i = 0; i < batch->numPlayers; i++) {
+        if ((batch->strategies[i] = strategy_from_path(argv[3 + i])) == -1) {
+            sim_exit(INVALID_ARG);
+        }
+    }
+
+    game = make_game(batch->numPlayers, batch->numCarriages, DEFAULT_LEVELS,
+            DEFAULT_ROUNDS, seed);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long played = 0; played < simOptions.games; played += lanes) {
+        lanes = simOptions.games - played < SIM_LANES
+                ? simOptions.games - played : SIM_LANES;
+        start_batch(batch, seed + played, lanes);
+        play_batch(batch);
+        for (int lane = 0; lane < lanes; lane++) {
+            numWinners = lane_winners(batch, lane, winners);
+            for (int i = 0; i < numWinners; i++) {
+                wins[winners[i] - 'A']++;
+            }
+            for (int i = 0; i < batch->numPlayers; i++) {
+                loot[i] += batch->loot[i][lane];
+            }
+            if (simOptions.list) {
+                lane_game(batch, lane, game);
+                print_game_state(game, stdout, simOptions.format);
+                print_winners(stdout, simOptions.format, winners,
+                        numWinners);
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // Totals over every game
+    if (!simOptions.list) {
+        for (int i = 0; i < batch->numPlayers; i++) {
+            printf("%c %s: won %ld, loot %ld\n", 'A' + i,
+                    names[batch->strategies[i]], wins[i], loot[i]);
+        }
+    }
+    fflush(stdout);
+    fprintf(stderr, "%ld games in %.3fs\n", simOptions.games,
+            (end.tv_sec - start.tv_sec)
+            + (end.tv_nsec - start.tv_nsec) / 1e9);
+    free_game(game);
+    free(batch);
+    return EXIT_SUCCESS;
+}
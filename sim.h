@@ -0,0 +1,199 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "shared.h"
+#include "packed.h"
+#include "output.h"
+
+/*
+ * ===========================================================================
+ * Simulator header file - plays many games of the built in strategies in
+ * one process, side by side.
+ * ===========================================================================
+ */
+
+/* Exit codes */
+#define EXIT_SUCCESS 0
+#define WRONG_ARGS 1
+#define INVALID_ARG 2
+#define PACK_FAIL 3
+
+/* Games played side by side in a batch */
+#define SIM_LANES 64
+/* Widest train the simulator plays, so lanes pack without loss */
+#define SIM_MAX_CARRIAGES PACKED_MAX_CARRIAGES
+
+/* Strategies the simulator plays, known by player program name */
+#define SIM_ACROPHOBE 0
+#define SIM_BANDIT 1
+#define SIM_SPOILER 2
+#define SIM_NUM_STRATEGIES 3
+#define SIM_STRATEGY_NAMES {"acrophobe", "bandit", "spoiler"}
+
+/* Hot loops are built for each of these and picked when the simulator
+ * starts, by what the CPU supports */
+#define SIM_CLONES __attribute__((target_clones("avx512f", "avx2", \
+        "default")))
+
+/* Typedef Structs for readability */
+typedef struct SimOptions SimOptions;
+typedef struct SimBatch Batch;
+typedef struct SimSight Sight;
+
+/* Flags given before the seed */
+struct SimOptions {
+    // Games to play, with seeds counting up from the one given.
+    long games;
+    // Print each game's final state and winners.
+    bool list;
+    // Output format for listed games.
+    int format;
+};
+
+/* Options before any flags are read */
+#define DEFAULT_SIM_OPTIONS {.games = 1, .format = FORMAT_TEXT}
+
+/*
+ * Games with the same lineup and train, one game per lane. Everything is
+ * indexed by player or train spot, then lane, so one step of every game
+ * is a pass over contiguous lanes.
+ */
+struct SimBatch {
+    int numPlayers;
+    int numCarriages;
+    // Lanes in use, the rest are left as they were.
+    int numLanes;
+    int strategies[MAX_PLAYERS];
+    unsigned int seeds[SIM_LANES];
+    int16_t x[MAX_PLAYERS][SIM_LANES];
+    int16_t y[MAX_PLAYERS][SIM_LANES];
+    int16_t loot[MAX_PLAYERS][SIM_LANES];
+    int16_t hits[MAX_PLAYERS][SIM_LANES];
+    // Last order and horizontal direction, as in Player orders.
+    int16_t last[MAX_PLAYERS][SIM_LANES];
+    int16_t direction[MAX_PLAYERS][SIM_LANES];
+    // Orders of the round being played.
+    int16_t order[MAX_PLAYERS][SIM_LANES];
+    // Loot in each lower carriage, then each upper carriage.
+    int16_t train[2 * SIM_MAX_CARRIAGES][SIM_LANES];
+};
+
+/* What one player sees around it in each lane, as the strategies use */
+struct SimSight {
+    // Highest id player in the same spot, -1 if none.
+    int16_t shortTarget[SIM_LANES];
+    // Lowest id player that may be shot long, -1 if none.
+    int16_t longLowest[SIM_LANES];
+    // The spoiler's long target: nearest on each side, highest id on ties,
+    // then the higher id of the two sides. -1 if none.
+    int16_t longNearest[SIM_LANES];
+    // 1 if a player is in the same carriage on the other level.
+    int16_t otherLevel[SIM_LANES];
+    // Players in carriages to the left and right.
+    int16_t playersLeft[SIM_LANES];
+    int16_t playersRight[SIM_LANES];
+    // Loot in this spot, in carriages either side and on each level.
+    int16_t lootHere[SIM_LANES];
+    int16_t lootLeft[SIM_LANES];
+    int16_t lootRight[SIM_LANES];
+    int16_t lootLower[SIM_LANES];
+    int16_t lootUpper[SIM_LANES];
+    // Way to the nearest other carriage with loot, -1 or 1, ties to the
+    // left. 0 if there is loot in this carriage or none on the train.
+    int16_t lootNearest[SIM_LANES];
+};
+
+/*
+ * ===========================================================================
+ * Simulator functions
+ * ===========================================================================
+ */
+/*
+ * Exits with a message for the exit status.
+ *
+ * @param exitStatus    one of the exit codes.
+ */
+void sim_exit(int exitStatus);
+
+/*
+ * Reads flags given before the seed into the simulator options.
+ *
+ * @param argc      count of arguments provided
+ * @param argv      array of pointers to arguments provided
+ * @return number of arguments consumed by flags.
+ */
+int parse_sim_options(int argc, char **argv);
+
+/*
+ * Finds the strategy of a player program, by the program's name.
+ *
+ * @param path      path to the player program, e.g. ./bandit.
+ * @return one of the SIM_ strategies, or -1 if it can't be simulated.
+ */
+int strategy_from_path(char *path);
+
+/*
+ * Sets up a game in each lane, as make_game would for its seed.
+ *
+ * @param *batch    batch with its lineup and train width set.
+ * @param seed      seed of the first lane, later lanes count up from it.
+ * @param numLanes  lanes to use, at most SIM_LANES.
+ */
+void start_batch(Batch *batch, unsigned int seed, int numLanes);
+
+/*
+ * Looks around a player in every lane.
+ *
+ * @param *batch    the games.
+ * @param id        the player looking.
+ * @param *sight    where to store what it sees.
+ */
+void look_around(Batch *batch, int id, Sight *sight);
+
+/*
+ * Gives every player its order for the round, from the state at the
+ * start of the round, as the hub asks for them.
+ *
+ * @param *batch    the games.
+ */
+void order_round(Batch *batch);
+
+/*
+ * Runs one player's order in every lane, choosing its direction or target
+ * as the player or hub would once it is run.
+ *
+ * @param *batch    the games.
+ * @param id        the player whose order is run.
+ */
+void run_orders(Batch *batch, int id);
+
+/*
+ * Plays every round of the games in a batch.
+ *
+ * @param *batch    the games, as set up by start_batch.
+ */
+void play_batch(Batch *batch);
+
+/*
+ * Copies the state of one lane into a game of the same size.
+ *
+ * @param *batch    the games.
+ * @param lane      the lane to copy.
+ * @param *game     game made with make_game for the same players and
+ *                  carriages.
+ */
+void lane_game(Batch *batch, int lane, Game *game);
+
+/*
+ * Finds the winners of one lane, everyone with the most loot.
+ *
+ * @param *batch    the games.
+ * @param lane      the lane whose game is over.
+ * @param winners   where to store the winners' symbols.
+ * @return how many players won.
+ */
+int lane_winners(Batch *batch, int lane, char winners[]);
+
+#endif
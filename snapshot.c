@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include "snapshot.h"
+#include "output.h"
+#include "comms.h"
+
+/*
+ * ===========================================================================
+ * CSSE2310 Assignment 3
+ * SNAPSHOT - Saving and restoring games between rounds
+ * ===========================================================================
+ */
+
+/* Function prototypes local to snapshot */
+bool field_matches(uint32_t value, int expected);
+bool orders_valid(char orders[]);
+
+/*
+ * Checks a header field of a snapshot against the game's value. Fields
+ * too large for an int can't match, so the cast is only made in range.
+ *
+ * @param value     the field as read.
+ * @param expected  the game's value.
+ * @return true if they are the same.
+ */
+bool field_matches(uint32_t value, int expected) {
+    return value <= INT_MAX && (int) value == expected;
+}
+
+/*
+ * Checks a player's last orders from a snapshot: an order of VALID_MOVES
+ * and the last horizontal direction, either '\0' if there hasn't been one.
+ *
+ * @param orders    the two order bytes as read.
+ * @return true if both could have been played.
+ */
+bool orders_valid(char orders[]) {
+    return (orders[0] == '\0' || strchr(VALID_MOVES, orders[0]) != NULL)
+            && (orders[1] == '\0' || orders[1] == DIR_LEFT
+            || orders[1] == DIR_RIGHT);
+}
+
+/*
+ * Writes a snapshot of the game. The file is replaced in one step, so a
+ * crash while saving leaves the previous snapshot in place.
+ *
+ * @param *game     game to save.
+ * @param path      file to save to.
+ * @return true if saved, false otherwise.
+ */
+bool save_snapshot(Game *game, char *path) {
+    char tempPath[strlen(path) + 5];
+    Player *player;
+    FILE *file;
+
+    sprintf(tempPath, "%s.tmp", path);
+    if ((file = fopen(tempPath, "wb")) == NULL) {
+        return false;
+    }
+
+    fwrite(SNAPSHOT_MAGIC, 1, strlen(SNAPSHOT_MAGIC), file);
+    put_u32(file, SNAPSHOT_VERSION);
+    put_u32(file, game->seed);
+    put_u32(file, game->numCarriages);
+    put_u32(file, game->numLevels);
+    put_u32(file, game->numRounds);
+    put_u32(file, game->numPlayers);
+    put_u32(file, game->round);
+    for (int i = 0; i < game->numPlayers; i++) {
+        player = game->players[i];
+        put_u32(file, player->pos.x);
+        put_u32(file, player->pos.y);
+        put_u32(file, player->loot);
+        put_u32(file, player->hits);
+        fputc(player->orders[0], file);
+        fputc(player->orders[1], file);
+    }
+    for (int i = 0; i < train_size(game); i++) {
+        put_u32(file, game->train[i]);
+    }
+
+    if (fclose(file) == EOF) {
+        return false;
+    }
+    return rename(tempPath, path) == 0;
+}
+
+/*
+ * Restores the state of a game from a snapshot. The snapshot must be of
+ * a game with the same seed, train, rounds and number of players.
+ *
+ * @param *game     game to restore into, made with make_game.
+ * @param path      file to restore from.
+ * @return true if restored, false if the snapshot can't be used.
+ */
+bool load_snapshot(Game *game, char *path) {
+    char magic[strlen(SNAPSHOT_MAGIC)];
+    uint32_t version, seed, numCarriages, numLevels, numRounds, numPlayers,
+            round, value[4];
+    bool valid;
+    Player *player;
+    FILE *file;
+
+    if ((file = fopen(path, "rb")) == NULL) {
+        return false;
+    }
+
+    // Header must match the game we have been asked to play.
+    valid = fread(magic, 1, sizeof(magic), file) == sizeof(magic)
+            && memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0
+            && get_u32(file, &version) && version == SNAPSHOT_VERSION
+            && get_u32(file, &seed) && seed == game->seed
+            && get_u32(file, &numCarriages)
+            && field_matches(numCarriages, game->numCarriages)
+            && get_u32(file, &numLevels)
+            && field_matches(numLevels, game->numLevels)
+            && get_u32(file, &numRounds)
+            && field_matches(numRounds, game->numRounds)
+            && get_u32(file, &numPlayers)
+            && field_matches(numPlayers, game->numPlayers)
+            && get_u32(file, &round) && round <= INT_MAX;
+    if (valid) {
+        game->round = (int) round;
+    }
+
+    for (int i = 0; valid && i < game->numPlayers; i++) {
+        player = game->players[i];
+        for (int j = 0; valid && j < 4; j++) {
+            valid = get_u32(file, &value[j]);
+        }
+        valid = valid && value[0] < numCarriages && value[1] < numLevels
+                && value[2] <= INT_MAX && value[3] <= INT_MAX
+                && fread(player->orders, 1, 2, file) == 2
+                && orders_valid(player->orders);
+        player->pos.x = value[0];
+        player->pos.y = value[1];
+        player->loot = value[2];
+        player->hits = value[3];
+    }
+    for (int i = 0; valid && i < train_size(game); i++) {
+        valid = get_u32(file, &value[0]) && value[0] <= INT_MAX;
+        game->train[i] = value[0];
+    }
+
+    fclose(file);
+    game->hash = hash_game(game);
+    index_loot(game);
+    return valid;
+}
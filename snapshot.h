@@ -0,0 +1,49 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "shared.h"
+
+/*
+ * ===========================================================================
+ * Snapshot header file - saving and restoring games between rounds.
+ * ===========================================================================
+ */
+
+/*
+ * Snapshot file layout, all values little endian u32 unless noted:
+ *  magic "TLSN" (4 bytes), version, seed, carriages, levels, rounds,
+ *  players, round,
+ *  then per player x, y, loot, hits, last order (u8), last direction (u8),
+ *  then loot in each carriage on each level in turn, lowest first.
+ */
+#define SNAPSHOT_MAGIC "TLSN"
+#define SNAPSHOT_VERSION 2
+
+/*
+ * ===========================================================================
+ * Snapshot functions
+ * ===========================================================================
+ */
+/*
+ * Writes a snapshot of the game. The file is replaced in one step, so a
+ * crash while saving leaves the previous snapshot in place.
+ *
+ * @param *game     game to save.
+ * @param path      file to save to.
+ * @return true if saved, false otherwise.
+ */
+bool save_snapshot(Game *game, char *path);
+
+/*
+ * Restores the state of a game from a snapshot. The snapshot must be of
+ * a game with the same seed, train, rounds and number of players.
+ *
+ * @param *game     game to restore into, made with make_game.
+ * @param path      file to restore from.
+ * @return true if restored, false if the snapshot can't be used.
+ */
+bool load_snapshot(Game *game, char *path);
+
+#endif
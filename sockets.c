@@ -0,0 +1,87 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "sockets.h"
+#include "shared.h"
+
+/*
+ * ===========================================================================
+ * CSSE2310 Assignment 3
+ * SOCKETS - Local sockets for players that connect to the hub
+ * ===========================================================================
+ */
+
+/* Function prototypes local to sockets */
+bool socket_address(char *path, struct sockaddr_un *address);
+
+/*
+ * Fills in the address of a Unix domain socket.
+ *
+ * @param path      file system path of the socket.
+ * @param *address  address to fill in.
+ * @return true if the path fits in an address, else false.
+ */
+bool socket_address(char *path, struct sockaddr_un *address) {
+    if (strlen(path) >= sizeof(address->sun_path)) {
+        return false;
+    }
+    memset(address, 0, sizeof(struct sockaddr_un));
+    address->sun_family = AF_UNIX;
+    strcpy(address->sun_path, path);
+    return true;
+}
+
+/*
+ * Listens for connections on a Unix domain socket. A socket left behind
+ * at the path by an earlier hub is replaced.
+ *
+ * @param path      file system path of the socket.
+ * @return the listening socket, or -1 on failure.
+ */
+int listen_socket(char *path) {
+    struct sockaddr_un address;
+    struct stat info;
+    int server;
+
+    if (!socket_address(path, &address)
+            || (server = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+        return -1;
+    }
+    // Never remove anything that isn't a socket
+    if (stat(path, &info) == 0 && S_ISSOCK(info.st_mode)) {
+        unlink(path);
+    }
+    if (bind(server, (struct sockaddr *) &address, sizeof(address)) == -1
+            || listen(server, MAX_PLAYERS) == -1) {
+        close(server);
+        return -1;
+    }
+    return server;
+}
+
+/*
+ * Connects to a Unix domain socket.
+ *
+ * @param path      file system path of the socket.
+ * @return the connected socket, or -1 on failure.
+ */
+int connect_socket(char *path) {
+    struct sockaddr_un address;
+    int client;
+
+    if (!socket_address(path, &address)
+            || (client = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+        return -1;
+    }
+    if (connect(client, (struct sockaddr *) &address, sizeof(address))
+            == -1) {
+        close(client);
+        return -1;
+    }
+    return client;
+}
@@ -0,0 +1,32 @@
+#ifndef SOCKETS_H
+#define SOCKETS_H
+
+/*
+ * ===========================================================================
+ * Sockets header file - local sockets for players that connect to the hub.
+ * ===========================================================================
+ */
+
+/*
+ * ===========================================================================
+ * Socket functions
+ * ===========================================================================
+ */
+/*
+ * Listens for connections on a Unix domain socket. A socket left behind
+ * at the path by an earlier hub is replaced.
+ *
+ * @param path      file system path of the socket.
+ * @return the listening socket, or -1 on failure.
+ */
+int listen_socket(char *path);
+
+/*
+ * Connects to a Unix domain socket.
+ *
+ * @param path      file system path of the socket.
+ * @return the connected socket, or -1 on failure.
+ */
+int connect_socket(char *path);
+
+#endif
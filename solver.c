@@ -0,0 +1,454 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "player.h"
+#include "banditrules.h"
+#include "comms.h"
+#include "logging.h"
+
+/*
+ * ===========================================================================
+ * 2310 Assignment 3
+ * SOLVER Player
+ * Follows the bandit rules until the last rounds of the game, then
+ * searches every line of play to the end.
+ * ===========================================================================
+ */
+/* Rounds left, the current one included, when search takes over */
+#define SOLVER_ROUNDS 3
+/* Nodes a decision may search before falling back, about 200ms. Counted
+ * rather than timed, so the same game always plays out the same way. */
+#define SOLVER_MAX_NODES 500000
+/* Transposition table entries, a power of two. 1 MiB of table. */
+#define SOLVER_TABLE_SIZE (1 << 16)
+/* Most actions a player has in one turn */
+#define SOLVER_MAX_ACTIONS (6 + 2 * MAX_PLAYERS)
+/* Worse than any loot margin */
+#define SOLVER_INFINITY 1000
+
+/* Parts of a table key on top of the game hash */
+#define KEY_PLIES (1 << 30)
+#define KEY_DRYING (KEY_PLIES + 1)
+#define KEY_ROOT_ORDER (KEY_PLIES + 2)
+
+/* What a table entry's value is known to be */
+#define BOUND_EXACT 0
+#define BOUND_LOWER 1
+#define BOUND_UPPER 2
+
+/* Typedef Structs for readability */
+typedef struct SolverEntry Entry;
+typedef struct SolverSearch Search;
+
+/* Transposition table entry, empty while its key is 0 */
+struct SolverEntry {
+    uint64_t key;
+    short value;
+    char bound;
+    Action best;
+};
+
+/* A search for one decision */
+struct SolverSearch {
+    Game *game;
+    int me;
+    // Order types announced this round, '\0' if not known. Mine is the
+    // order being tried.
+    char announced[MAX_PLAYERS];
+    // Plies left once the current round is over.
+    int laterPlies;
+    Entry *table;
+    long nodes;
+    bool outOfNodes;
+};
+
+/* Function prototypes unique for player */
+int rounds_left(Game *game);
+int add_targets(Action actions[], int count, char order,
+        unsigned int targets, bool always);
+int list_actions(Game *game, int id, char order, Action actions[]);
+unsigned int drying_players(Game *game, char announced[]);
+int evaluate(Game *game, int me);
+bool out_of_nodes(Search *search);
+int search_turn(Search *search, int turn, int plies, unsigned int drying,
+        int alpha, int beta);
+int search_root(Search *search, char order, int rounds, Action *best);
+bool solve(Game *game, int id, char order, Action *best);
+
+ /*
+  * ===========================================================================
+  * Player Game Functions
+  * ===========================================================================
+  */
+
+/*
+ * Works out how many rounds are left, the current one included.
+ *
+ * @param *game     player's view of the game state.
+ * @return rounds left to play.
+ */
+int rounds_left(Game *game) {
+    // The round count is one ahead once a round has started
+    return game->numRounds + 2 - game->round;
+}
+
+ /*
+  * ===========================================================================
+  * Search Functions. Each round is searched as if every player picks its
+  * whole action when it is run, knowing what was run before it. Players
+  * other than this one are assumed to play against it.
+  * ===========================================================================
+  */
+
+/*
+ * Adds a shot at each target in a set.
+ *
+ * @param actions   actions listed so far.
+ * @param count     how many are listed.
+ * @param order     SHOOT_S or SHOOT_L.
+ * @param targets   bit i set if player i may be shot.
+ * @param always    true to add a shot at no one if there are no targets.
+ * @return how many actions are listed after adding.
+ */
+int add_targets(Action actions[], int count, char order,
+        unsigned int targets, bool always) {
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (targets >> i & 1) {
+            actions[count++] = (Action) {order, 'A' + i};
+        }
+    }
+    if (targets == 0 && always) {
+        actions[count++] = (Action) {order, NO_TARGET};
+    }
+    return count;
+}
+
+/*
+ * Lists the actions a player may take, loot and shots first as they
+ * tend to matter most.
+ *
+ * @param *game     the game being searched.
+ * @param id        the player acting.
+ * @param order     order type the player is held to, '\0' if any.
+ * @param actions   array of SOLVER_MAX_ACTIONS to list actions in.
+ * @return how many actions were listed.
+ */
+int list_actions(Game *game, int id, char order, Action actions[]) {
+    int count = 0;
+    Legal legal;
+
+    find_legal(game, id, &legal);
+    if (order == DRY) {
+        actions[count++] = (Action) {DRY, '\0'};
+    }
+    if (order == '\0' || order == LOOT) {
+        actions[count++] = (Action) {LOOT, '\0'};
+    }
+    // A shot at no one only matters once it is ordered
+    if (order == '\0' || order == SHOOT_S) {
+        count = add_targets(actions, count, SHOOT_S, legal.shortTargets,
+                order == SHOOT_S);
+    }
+    if (order == '\0' || order == SHOOT_L) {
+        count = add_targets(actions, count, SHOOT_L, legal.longTargets,
+                order == SHOOT_L);
+    }
+    if ((order == '\0' || order == MOVE_H) && (legal.moves & LEGAL_LEFT)) {
+        actions[count++] = (Action) {MOVE_H, DIR_LEFT};
+    }
+    if ((order == '\0' || order == MOVE_H) && (legal.moves & LEGAL_RIGHT)) {
+        actions[count++] = (Action) {MOVE_H, DIR_RIGHT};
+    }
+    if (order == '\0' || order == MOVE_V) {
+        actions[count++] = (Action) {MOVE_V, '\0'};
+    }
+    return count;
+}
+
+/*
+ * Finds the players who dry out this round instead of ordering.
+ *
+ * @param *game         the game being searched.
+ * @param announced     order types announced this round, NULL if none.
+ * @return bit i set if player i dries out.
+ */
+unsigned int drying_players(Game *game, char announced[]) {
+    unsigned int drying = 0;
+
+    for (int i = 0; i < game->numPlayers; i++) {
+        if (game->players[i]->hits >= 3
+                && (announced == NULL || announced[i] == '\0')) {
+            drying |= 1u << i;
+        }
+    }
+    return drying;
+}
+
+/*
+ * Scores a game for a player, as its loot ahead of the best other player.
+ *
+ * @param *game     the game being searched.
+ * @param me        the player scored for.
+ * @return the loot margin, negative if behind.
+ */
+int evaluate(Game *game, int me) {
+    int best = -SOLVER_INFINITY;
+
+    for (int i = 0; i < game->numPlayers; i++) {
+        if (i != me && game->players[i]->loot > best) {
+            best = game->players[i]->loot;
+        }
+    }
+    return game->players[me]->loot - best;
+}
+
+/*
+ * Counts a node, checking if the search has used up its SOLVER_MAX_NODES.
+ *
+ * @param *search   the search running.
+ * @return true if the search must stop, else false.
+ */
+bool out_of_nodes(Search *search) {
+    if (++search->nodes > SOLVER_MAX_NODES) {
+        search->outOfNodes = true;
+    }
+    return search->outOfNodes;
+}
+
+/*
+ * Searches from a player's turn with alpha-beta and a transposition
+ * table. Rounds start over once every player has had a turn.
+ *
+ * @param *search   the search running.
+ * @param turn      the player whose turn it is, numPlayers at round end.
+ * @param plies     turns left to search.
+ * @param drying    players drying out this round, see drying_players.
+ * @param alpha     score this player is already sure of.
+ * @param beta      score the other players can already hold it to.
+ * @return the score of the position, meaningless if out of nodes.
+ */
+int search_turn(Search *search, int turn, int plies, unsigned int drying,
+        int alpha, int beta) {
+    Game *game = search->game;
+    Action actions[SOLVER_MAX_ACTIONS], swap;
+    int numActions, value, best, bestIndex = 0, startAlpha = alpha,
+            startBeta = beta;
+    bool firstRound = plies > search->laterPlies, maximise;
+    char order = '\0';
+    uint64_t key;
+    Entry *entry;
+    Undo undo;
+
+    if (plies == 0) {
+        return evaluate(game, search->me);
+    }
+    if (out_of_nodes(search)) {
+        return 0;
+    }
+    if (turn == game->numPlayers) {
+        // Next round, orders are no longer known
+        turn = 0;
+        drying = drying_players(game, NULL);
+    }
+
+    // Check the table, the first round also depends on my order.
+    key = game->hash ^ state_key(KEY_PLIES, plies)
+            ^ state_key(KEY_DRYING, drying)
+            ^ state_key(KEY_ROOT_ORDER, firstRound
+            ? search->announced[search->me] : 0);
+    entry = &search->table[key & (SOLVER_TABLE_SIZE - 1)];
+    if (entry->key == key && (entry->bound == BOUND_EXACT
+            || (entry->bound == BOUND_LOWER && entry->value >= beta)
+            || (entry->bound == BOUND_UPPER && entry->value <= alpha))) {
+        return entry->value;
+    }
+
+    if (drying >> turn & 1) {
+        order = DRY;
+    } else if (firstRound) {
+        order = search->announced[turn];
+    }
+    numActions = list_actions(game, turn, order, actions);
+    // Try the best action found last time first
+    for (int i = 0; entry->key == key && i < numActions; i++) {
+        if (actions[i].order == entry->best.order
+                && actions[i].param == entry->best.param) {
+            swap = actions[0];
+            actions[0] = actions[i];
+            actions[i] = swap;
+            break;
+        }
+    }
+
+    maximise = turn == search->me;
+    best = maximise ? -SOLVER_INFINITY : SOLVER_INFINITY;
+    for (int i = 0; i < numActions && alpha < beta; i++) {
+        do_action(game, turn, actions[i], &undo);
+        value = search_turn(search, turn + 1, plies - 1, drying, alpha,
+                beta);
+        undo_action(game, &undo);
+        if (search->outOfNodes) {
+            return 0;
+        }
+        if (maximise ? value > best : value < best) {
+            best = value;
+            bestIndex = i;
+        }
+        if (maximise && best > alpha) {
+            alpha = best;
+        } else if (!maximise && best < beta) {
+            beta = best;
+        }
+    }
+
+    entry->key = key;
+    entry->value = best;
+    entry->bound = best <= startAlpha ? BOUND_UPPER
+            : best >= startBeta ? BOUND_LOWER : BOUND_EXACT;
+    entry->best = actions[bestIndex];
+    return best;
+}
+
+/*
+ * Searches a number of rounds ahead for this player's best choice. Before
+ * the round is run that is an order type, tried in turn against the
+ * whole round. Once running it is a direction or target for its order.
+ *
+ * @param *search   the search to run, with the announced orders set.
+ * @param order     this player's order type if running, else '\0'.
+ * @param rounds    rounds to search, the current one included.
+ * @param *best     where to store the best choice.
+ * @return the score of the best choice, meaningless if out of nodes.
+ */
+int search_root(Search *search, char order, int rounds, Action *best) {
+    Game *game = search->game;
+    char orders[] = {LOOT, SHOOT_S, SHOOT_L, MOVE_H, MOVE_V};
+    Action actions[SOLVER_MAX_ACTIONS];
+    int numActions, value, bestValue = -SOLVER_INFINITY, me = search->me;
+    int numPlayers = game->numPlayers;
+    unsigned int drying = drying_players(game, search->announced);
+    Undo undo;
+
+    search->laterPlies = (rounds - 1) * numPlayers;
+    if (order == '\0') {
+        // Whole round is to come, try each order for it
+        for (int i = 0; i < (int) sizeof(orders); i++) {
+            search->announced[me] = orders[i];
+            value = search_turn(search, 0, rounds * numPlayers, drying,
+                    bestValue, SOLVER_INFINITY);
+            if (value > bestValue || i == 0) {
+                bestValue = value;
+                *best = (Action) {orders[i], '\0'};
+            }
+        }
+        return bestValue;
+    }
+
+    // Players before me have run their orders
+    search->announced[me] = order;
+    numActions = list_actions(game, me, order, actions);
+    for (int i = 0; i < numActions; i++) {
+        do_action(game, me, actions[i], &undo);
+        value = search_turn(search, me + 1, rounds * numPlayers - me - 1,
+                drying, bestValue, SOLVER_INFINITY);
+        undo_action(game, &undo);
+        if (value > bestValue || i == 0) {
+            bestValue = value;
+            *best = actions[i];
+        }
+    }
+    return bestValue;
+}
+
+/*
+ * Searches deeper one round at a time until the end of the game or the
+ * nodes run out, keeping the choice of the deepest search finished.
+ *
+ * @param *game     player's view of the game state.
+ * @param id        this player's id.
+ * @param order     this player's order type if it is running, else '\0'.
+ * @param *best     where to store the best choice.
+ * @return true if at least one round was searched in budget, else false.
+ */
+bool solve(Game *game, int id, char order, Action *best) {
+    Search search = {.game = game, .me = id};
+    int left = rounds_left(game), solved = 0, value = 0;
+    Action choice;
+
+    search.table = (Entry *) calloc(SOLVER_TABLE_SIZE, sizeof(Entry));
+    if (search.table == NULL) {
+        return false;
+    }
+    for (int i = 0; i < game->numPlayers; i++) {
+        search.announced[i] = game->players[i]->newOrders[0];
+    }
+
+    for (int rounds = 1; rounds <= left; rounds++) {
+        int result = search_root(&search, order, rounds, &choice);
+        if (search.outOfNodes) {
+            break;
+        }
+        solved = rounds;
+        value = result;
+        *best = choice;
+    }
+    free(search.table);
+    player_log(LOG_EVENT, "%c searched %d of %d rounds, %+d loot, %ld nodes",
+            game->players[id]->symbol, solved, left, value, search.nodes);
+    return solved > 0;
+}
+
+/*
+ * Player chooses a direction or target according to hub request.
+ *
+ * @param *game     the player's view of the game state.
+ * @param id        this player's id
+ * @param message   the request from the hub
+ */
+void describe_action(Game *game, int id, char message[]) {
+    char action[2] = {'\0'}, order;
+    Action best;
+
+    if (strcmp(message, GET_DIR) == 0) {
+        order = MOVE_H;
+    } else if (strcmp(message, GET_S_TARGET) == 0) {
+        order = SHOOT_S;
+    } else {
+        order = SHOOT_L;
+    }
+    if (rounds_left(game) > SOLVER_ROUNDS || !solve(game, id, order,
+            &best)) {
+        bandit_action(game, id, message);
+        return;
+    }
+    action[0] = best.param;
+    send_message(stdout, order == MOVE_H ? GO_DIR
+            : order == SHOOT_S ? AIM_SHORT : AIM_LONG, action);
+}
+
+/*
+ * Player chooses a move based on its strategy. Searches once few rounds
+ * are left, otherwise plays as a bandit.
+ *
+ * @param *game     player's view of the game state.
+ * @param id        this player's id
+ */
+void choose_move(Game *game, int id) {
+    char move[3] = {'\0'};
+    Action best;
+
+    if (rounds_left(game) > SOLVER_ROUNDS || !solve(game, id, '\0',
+            &best)) {
+        bandit_move(game, id);
+        return;
+    }
+    // Direction or target is left until the order is run
+    move[0] = best.order;
+    send_message(stdout, PLAY, move);
+}
+
+int main(int argc, char **argv) {
+    player_main(argc, argv);
+
+    return EXIT_SUCCESS;
+}
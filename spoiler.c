@@ -55,34 +55,36 @@ int select_long(Game *game, int id) {
     int idLeft = -1, idRight = -1, closestLeft, closestRight;
     Position checkPos, playerPos;
     playerPos = game->players[id]->pos;
+    // Roof shots carry the length of the train, inside ones don't
+    bool roof = long_range(game, playerPos.y) > INSIDE_RANGE;
     for (int i = 0; i < game->numPlayers; i++) {
         checkPos = game->players[i]->pos;
         if (i != id && checkPos.y == playerPos.y && checkPos.x < playerPos.x
-                && playerPos.y == 1) {
-            // Check uppper long, left
+                && roof) {
+            // Check roof long, left
             if (idLeft == -1 || (i > idLeft && checkPos.x >= closestLeft)) {
                 idLeft = i;
                 closestLeft = checkPos.x;
             }
         } else if (i != id && checkPos.y == playerPos.y
-                && checkPos.x > playerPos.x && playerPos.y == 1) {
-            // Check upper long, right
+                && checkPos.x > playerPos.x && roof) {
+            // Check roof long, right
             if (idRight == -1 || (i > idRight
                     && checkPos.x <= closestRight)) {
                 idRight = i;
                 closestRight = checkPos.x;
             }
         } else if (i != id && checkPos.y == playerPos.y
-                && checkPos.x == playerPos.x - 1 && checkPos.x >= 0
-                && playerPos.y == 0) {
-            // Check lower long, left
+                && checkPos.x < playerPos.x
+                && playerPos.x - checkPos.x <= INSIDE_RANGE && !roof) {
+            // Check inside long, left
             if (idLeft == -1 || i > idLeft) {
                 idLeft = i;
             }
         } else if (i != id && checkPos.y == playerPos.y
-                && checkPos.x == playerPos.x + 1
-                && checkPos.x < game->numCarriages && playerPos.y == 0) {
-            // Check lower long, right
+                && checkPos.x > playerPos.x
+                && checkPos.x - playerPos.x <= INSIDE_RANGE && !roof) {
+            // Check inside long, right
             if (idRight == -1 || i > idRight) {
                 idRight = i;
             }
@@ -206,17 +208,18 @@ bool player_above_below(Game *game, int id) {
  */
 void choose_move(Game *game, int id) {
     // String containing reply from player
-    char move[2] = {'\0'};
+    char move[3] = {'\0'};
 
     // Current position of this player.
     Position currentPos = game->players[id]->pos;
-    int index = currentPos.y * game->numCarriages + currentPos.x;
+    int index = train_index(game, currentPos.x, currentPos.y);
     // Last order
     char order = game->players[id]->orders[0];
 
     // (1) Short or long if not used last turn
     if (order != SHOOT_S && order != SHOOT_L && player_here(game, id)) {
         move[0] = SHOOT_S;
+        move[1] = TARGET_HIGHEST;
     } else if (order != SHOOT_S && order != SHOOT_L &&
             has_long_target(game, id)) {
         move[0] = SHOOT_L;
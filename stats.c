@@ -0,0 +1,229 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "stats.h"
+#include "comms.h"
+#include "output.h"
+
+/*
+ * ===========================================================================
+ * CSSE2310 Assignment 3
+ * STATS - Counting what each player does
+ * ===========================================================================
+ */
+
+/* Function prototypes local to stats */
+int visit_slots(Stats *stats);
+void write_json_stats(FILE *to, Stats *stats);
+void write_binary_stats(FILE *to, Stats *stats);
+
+/*
+ * Gets how many visit counts each player has.
+ *
+ * @param *stats    the counts.
+ * @return one per carriage, or STATS_CARRIAGES for long trains.
+ */
+int visit_slots(Stats *stats) {
+    return stats->numCarriages < STATS_CARRIAGES ? stats->numCarriages
+            : STATS_CARRIAGES;
+}
+
+/*
+ * Clears the counts, ready for a game.
+ *
+ * @param *stats    the counts.
+ * @param *game     the game about to be played.
+ */
+void reset_stats(Stats *stats, Game *game) {
+    memset(stats, 0, sizeof(Stats));
+    stats->games = 1;
+    stats->numPlayers = game->numPlayers;
+    stats->numCarriages = game->numCarriages;
+}
+
+/*
+ * Counts an order run by a player.
+ *
+ * @param *stats    the counts.
+ * @param id        the player.
+ * @param order     the order, one of VALID_MOVES.
+ */
+void count_action(Stats *stats, int id, char order) {
+    char *found = strchr(VALID_MOVES, order);
+
+    if (found != NULL && order != '\0') {
+        stats->players[id].actions[found - VALID_MOVES]++;
+    }
+}
+
+/*
+ * Counts a shot by a player.
+ *
+ * @param *stats    the counts.
+ * @param id        the player shooting.
+ * @param landed    true if it had a target.
+ */
+void count_shot(Stats *stats, int id, bool landed) {
+    if (landed) {
+        stats->players[id].shotsLanded++;
+    } else {
+        stats->players[id].shotsNoTarget++;
+    }
+}
+
+/*
+ * Counts a loot order by a player.
+ *
+ * @param *stats    the counts.
+ * @param id        the player looting.
+ * @param picked    true if loot was picked up.
+ */
+void count_loot(Stats *stats, int id, bool picked) {
+    if (picked) {
+        stats->players[id].lootPicked++;
+    } else {
+        stats->players[id].lootMissed++;
+    }
+}
+
+/*
+ * Counts loot dropped by a player that was short shot.
+ *
+ * @param *stats    the counts.
+ * @param id        the player shot.
+ */
+void count_drop(Stats *stats, int id) {
+    stats->players[id].lootDropped++;
+}
+
+/*
+ * Counts the end of a round, and the carriage each player ended it in.
+ *
+ * @param *stats    the counts.
+ * @param *game     the game, after the round's orders are run.
+ */
+void count_round(Stats *stats, Game *game) {
+    long long slot;
+
+    stats->rounds++;
+    for (int i = 0; i < stats->numPlayers; i++) {
+        // Long trains share each slot between a span of carriages
+        slot = (long long) game->players[i]->pos.x * visit_slots(stats)
+                / stats->numCarriages;
+        stats->players[i].visits[slot]++;
+    }
+}
+
+/*
+ * Adds one set of counts to another, for summing games.
+ *
+ * @param *total    counts to add to, reset for the first game added.
+ * @param *stats    counts of another game with the same players and train.
+ */
+void add_stats(Stats *total, Stats *stats) {
+    PlayerStats *to, *from;
+
+    if (total->games == 0) {
+        *total = *stats;
+        return;
+    }
+    total->games += stats->games;
+    total->rounds += stats->rounds;
+    for (int i = 0; i < stats->numPlayers; i++) {
+        to = &total->players[i];
+        from = &stats->players[i];
+        for (int j = 0; j < STATS_ACTIONS; j++) {
+            to->actions[j] += from->actions[j];
+        }
+        to->shotsLanded += from->shotsLanded;
+        to->shotsNoTarget += from->shotsNoTarget;
+        to->lootPicked += from->lootPicked;
+        to->lootMissed += from->lootMissed;
+        to->lootDropped += from->lootDropped;
+        for (int j = 0; j < STATS_CARRIAGES; j++) {
+            to->visits[j] += from->visits[j];
+        }
+    }
+}
+
+/*
+ * Writes counts as a JSON object on one line.
+ *
+ * @param to        stream to write to.
+ * @param *stats    the counts.
+ */
+void write_json_stats(FILE *to, Stats *stats) {
+    PlayerStats *player;
+
+    fprintf(to, "{\"games\":%u,\"rounds\":%u,\"players\":[", stats->games,
+            stats->rounds);
+    for (int i = 0; i < stats->numPlayers; i++) {
+        player = &stats->players[i];
+        fprintf(to, "%s{\"id\":\"%c\",\"actions\":{", i == 0 ? "" : ",",
+                'A' + i);
+        for (int j = 0; j < STATS_ACTIONS; j++) {
+            fprintf(to, "%s\"%c\":%u", j == 0 ? "" : ",", VALID_MOVES[j],
+                    player->actions[j]);
+        }
+        fprintf(to, "},\"shots_landed\":%u,\"shots_no_target\":%u,"
+                "\"loot_picked\":%u,\"loot_missed\":%u,"
+                "\"loot_dropped\":%u,\"dry_rounds\":%u,\"visits\":[",
+                player->shotsLanded, player->shotsNoTarget,
+                player->lootPicked, player->lootMissed,
+                player->lootDropped,
+                player->actions[strchr(VALID_MOVES, DRY) - VALID_MOVES]);
+        for (int j = 0; j < visit_slots(stats); j++) {
+            fprintf(to, "%s%u", j == 0 ? "" : ",", player->visits[j]);
+        }
+        fprintf(to, "]}");
+    }
+    fprintf(to, "]}\n");
+}
+
+/*
+ * Writes counts as a little endian binary frame.
+ *
+ * @param to        stream to write to.
+ * @param *stats    the counts.
+ */
+void write_binary_stats(FILE *to, Stats *stats) {
+    PlayerStats *player;
+
+    fputc(FRAME_STATS, to);
+    put_u32(to, stats->games);
+    put_u32(to, stats->rounds);
+    fputc(stats->numPlayers, to);
+    fputc(visit_slots(stats), to);
+    for (int i = 0; i < stats->numPlayers; i++) {
+        player = &stats->players[i];
+        for (int j = 0; j < STATS_ACTIONS; j++) {
+            put_u32(to, player->actions[j]);
+        }
+        put_u32(to, player->shotsLanded);
+        put_u32(to, player->shotsNoTarget);
+        put_u32(to, player->lootPicked);
+        put_u32(to, player->lootMissed);
+        put_u32(to, player->lootDropped);
+        for (int j = 0; j < visit_slots(stats); j++) {
+            put_u32(to, player->visits[j]);
+        }
+    }
+}
+
+/*
+ * Writes counts as a JSON object on one line, or a little endian binary
+ * frame: tag, u32 games, u32 rounds, u8 players, u8 visit slots, then per
+ * player u32 of each action, shots landed and without a target, loot
+ * picked up, missed and dropped, then each visit slot.
+ *
+ * @param to        stream to write to.
+ * @param *stats    the counts.
+ * @param format    FORMAT_BINARY for a frame, any other format for JSON.
+ */
+void write_stats(FILE *to, Stats *stats, int format) {
+    if (format == FORMAT_BINARY) {
+        write_binary_stats(to, stats);
+    } else {
+        write_json_stats(to, stats);
+    }
+}
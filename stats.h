@@ -0,0 +1,127 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "shared.h"
+
+/*
+ * ===========================================================================
+ * Stats header file - counting what each player does over a game, so
+ * strategies can be compared without reading every round's state.
+ * ===========================================================================
+ */
+
+/* Orders counted, in the order of VALID_MOVES */
+#define STATS_ACTIONS 6
+/* Carriage visits are kept exactly for trains up to this long, longer
+ * trains are split into this many equal spans */
+#define STATS_CARRIAGES 64
+
+/* Typedef Structs for readability */
+typedef struct PlayerStats PlayerStats;
+typedef struct GameStats Stats;
+
+/* What one player did */
+struct PlayerStats {
+    // Orders run, indexed as VALID_MOVES, 'd' is rounds spent drying.
+    uint32_t actions[STATS_ACTIONS];
+    // Shots with a target, and those with none.
+    uint32_t shotsLanded;
+    uint32_t shotsNoTarget;
+    // Loot orders that picked loot up, and those in empty spots.
+    uint32_t lootPicked;
+    uint32_t lootMissed;
+    // Loot dropped after being short shot.
+    uint32_t lootDropped;
+    // Rounds ended in each carriage, or span of carriages.
+    uint32_t visits[STATS_CARRIAGES];
+};
+
+/* What every player did in one or more games */
+struct GameStats {
+    uint32_t games;
+    uint32_t rounds;
+    int numPlayers;
+    int numCarriages;
+    PlayerStats players[MAX_PLAYERS];
+};
+
+/*
+ * ===========================================================================
+ * Stats functions
+ * ===========================================================================
+ */
+/*
+ * Clears the counts, ready for a game.
+ *
+ * @param *stats    the counts.
+ * @param *game     the game about to be played.
+ */
+void reset_stats(Stats *stats, Game *game);
+
+/*
+ * Counts an order run by a player.
+ *
+ * @param *stats    the counts.
+ * @param id        the player.
+ * @param order     the order, one of VALID_MOVES.
+ */
+void count_action(Stats *stats, int id, char order);
+
+/*
+ * Counts a shot by a player.
+ *
+ * @param *stats    the counts.
+ * @param id        the player shooting.
+ * @param landed    true if it had a target.
+ */
+void count_shot(Stats *stats, int id, bool landed);
+
+/*
+ * Counts a loot order by a player.
+ *
+ * @param *stats    the counts.
+ * @param id        the player looting.
+ * @param picked    true if loot was picked up.
+ */
+void count_loot(Stats *stats, int id, bool picked);
+
+/*
+ * Counts loot dropped by a player that was short shot.
+ *
+ * @param *stats    the counts.
+ * @param id        the player shot.
+ */
+void count_drop(Stats *stats, int id);
+
+/*
+ * Counts the end of a round, and the carriage each player ended it in.
+ *
+ * @param *stats    the counts.
+ * @param *game     the game, after the round's orders are run.
+ */
+void count_round(Stats *stats, Game *game);
+
+/*
+ * Adds one set of counts to another, for summing games.
+ *
+ * @param *total    counts to add to, reset for the first game added.
+ * @param *stats    counts of another game with the same players and train.
+ */
+void add_stats(Stats *total, Stats *stats);
+
+/*
+ * Writes counts as a JSON object on one line, or a little endian binary
+ * frame: tag, u32 games, u32 rounds, u8 players, u8 visit slots, then per
+ * player u32 of each action, shots landed and without a target, loot
+ * picked up, missed and dropped, then each visit slot.
+ *
+ * @param to        stream to write to.
+ * @param *stats    the counts.
+ * @param format    FORMAT_BINARY for a frame, any other format for JSON.
+ */
+void write_stats(FILE *to, Stats *stats, int format);
+
+#endif
@@ -0,0 +1,27 @@
+#!/bin/bash
+# Plays each game twice and checks both runs print the same thing. Every
+# player must play the same game the same way, whatever the machine load,
+# for --sync and --cache to hold.
+cd "$(dirname "$0")/.." || exit 1
+out=$(mktemp -d)
+trap 'rm -rf "$out"' EXIT
+status=0
+
+check() {
+    local name=$1
+    shift
+    ./2310express "$@" > "$out/$name.1" 2> /dev/null &
+    ./2310express "$@" > "$out/$name.2" 2> /dev/null &
+    wait
+    if cmp -s "$out/$name.1" "$out/$name.2"; then
+        echo "same: $*"
+    else
+        echo "DIFFERENT: $*"
+        status=1
+    fi
+}
+
+check default 2 12 ./solver ./bandit ./spoiler ./solver
+check synced -u -m -y 1 2 12 ./solver ./bandit ./spoiler ./solver
+check simultaneous -s 7 9 ./solver ./acrophobe ./bandit ./spoiler
+exit $status
@@ -0,0 +1,202 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include "trace.h"
+
+/*
+ * ===========================================================================
+ * CSSE2310 Assignment 3
+ * TRACE - Timeline of hub phases for trace viewers
+ * ===========================================================================
+ */
+
+// File the trace is written to, NULL if not tracing.
+FILE *traceFile;
+// Process that owns the trace
+pid_t tracePid;
+// Preallocated spans and tracks
+Span *spans;
+int numSpans;
+int droppedSpans;
+Track tracks[TRACE_MAX_TRACKS];
+int numTracks;
+// Time tracing started, spans are relative to it.
+long long traceStart;
+
+/* Function prototypes local to trace */
+long long trace_now(void);
+void write_json_string(const char *text);
+
+/*
+ * Gets the current monotonic time.
+ *
+ * @return time in nanoseconds.
+ */
+long long trace_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/*
+ * Writes a string as a quoted JSON string, escaping quotes, backslashes
+ * and control characters, so player paths can't break the trace.
+ *
+ * @param text      the string to write.
+ */
+void write_json_string(const char *text) {
+    fputc('"', traceFile);
+    for (; *text != '\0'; text++) {
+        if (*text == '"' || *text == '\\') {
+            fprintf(traceFile, "\\%c", *text);
+        } else if ((unsigned char) *text < 0x20) {
+            fprintf(traceFile, "\\u%04x", (unsigned char) *text);
+        } else {
+            fputc(*text, traceFile);
+        }
+    }
+    fputc('"', traceFile);
+}
+
+/*
+ * Starts tracing into a preallocated buffer, written to path at exit.
+ *
+ * @param path      file to write the trace to.
+ * @return true if tracing started, false if the file can't be opened.
+ */
+bool trace_open(char *path) {
+    if ((traceFile = fopen(path, "w")) == NULL) {
+        return false;
+    }
+    spans = (Span *) malloc(sizeof(Span) * TRACE_MAX_EVENTS);
+    tracePid = getpid();
+    traceStart = trace_now();
+    trace_name_track(TRACE_HUB, "hub");
+    return true;
+}
+
+/*
+ * Checks if tracing is on.
+ *
+ * @return true if spans are being recorded.
+ */
+bool tracing(void) {
+    return traceFile != NULL;
+}
+
+/*
+ * Names a track, shown as a thread in the trace viewer.
+ *
+ * @param track     the track, TRACE_HUB or TRACE_PLAYER of an id.
+ * @param format    printf style name of the track.
+ */
+void trace_name_track(int track, const char *format, ...) {
+    va_list args;
+
+    if (!tracing() || numTracks == TRACE_MAX_TRACKS) {
+        return;
+    }
+    tracks[numTracks].track = track;
+    va_start(args, format);
+    vsnprintf(tracks[numTracks].name, TRACE_NAME_LEN, format, args);
+    va_end(args);
+    numTracks++;
+}
+
+/*
+ * Starts a span on a track.
+ *
+ * @param track     the track, TRACE_HUB or TRACE_PLAYER of an id.
+ * @param name      static name of the span.
+ * @param format    printf style detail shown with the span.
+ * @return the span, to be passed to trace_end, or -1 if not recorded.
+ */
+int trace_begin(int track, const char *name, const char *format, ...) {
+    va_list args;
+    Span *span;
+
+    if (!tracing()) {
+        return -1;
+    } else if (numSpans == TRACE_MAX_EVENTS) {
+        droppedSpans++;
+        return -1;
+    }
+    span = &spans[numSpans];
+    span->name = name;
+    span->track = track;
+    va_start(args, format);
+    vsnprintf(span->detail, TRACE_DETAIL_LEN, format, args);
+    va_end(args);
+    span->duration = 0;
+    span->start = trace_now() - traceStart;
+    return numSpans++;
+}
+
+/*
+ * Ends a span started with trace_begin.
+ *
+ * @param span      the span returned by trace_begin.
+ */
+void trace_end(int span) {
+    if (span >= 0) {
+        spans[span].duration = trace_now() - traceStart - spans[span].start;
+    }
+}
+
+/*
+ * Stops tracing without writing anything, so a forked process can start
+ * a trace of its own rather than add to its parent's.
+ */
+void trace_close(void) {
+    if (!tracing()) {
+        return;
+    }
+    // Nothing is written before trace_write, so there is nothing to flush
+    fclose(traceFile);
+    traceFile = NULL;
+    free(spans);
+    spans = NULL;
+    numSpans = 0;
+    droppedSpans = 0;
+    numTracks = 0;
+}
+
+/*
+ * Writes all recorded spans as trace-event JSON. Only the process that
+ * started tracing writes, forked children never do.
+ */
+void trace_write(void) {
+    Span *span;
+
+    if (!tracing() || getpid() != tracePid) {
+        return;
+    }
+    fprintf(traceFile, "{\"traceEvents\":[\n");
+    for (int i = 0; i < numTracks; i++) {
+        fprintf(traceFile, "{\"name\":\"thread_name\",\"ph\":\"M\","
+                "\"pid\":%d,\"tid\":%d,\"args\":{\"name\":", tracePid,
+                tracks[i].track);
+        write_json_string(tracks[i].name);
+        fprintf(traceFile, "}},\n");
+    }
+    for (int i = 0; i < numSpans; i++) {
+        span = &spans[i];
+        fprintf(traceFile, "{\"name\":");
+        write_json_string(span->name);
+        fprintf(traceFile, ",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"detail\":",
+                tracePid, span->track, span->start / 1000.0,
+                span->duration / 1000.0);
+        write_json_string(span->detail);
+        fprintf(traceFile, "}},\n");
+    }
+    fprintf(traceFile, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+            "\"args\":{\"name\":\"2310express\"}}\n],"
+            "\"otherData\":{\"droppedSpans\":%d}}\n", tracePid,
+            droppedSpans);
+    fclose(traceFile);
+    traceFile = NULL;
+}
@@ -0,0 +1,104 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/*
+ * ===========================================================================
+ * Trace header file - timeline of hub phases in Chrome trace-event JSON.
+ * ===========================================================================
+ */
+
+/* Trace constraints */
+#define TRACE_MAX_EVENTS 65536
+#define TRACE_MAX_TRACKS 32
+#define TRACE_DETAIL_LEN 16
+#define TRACE_NAME_LEN 64
+
+/* Tracks are the hub, then each player by id, so players connected over
+ * a socket without a pid still get a track each */
+#define TRACE_HUB 0
+#define TRACE_PLAYER(id) ((id) + 1)
+
+/* Typedef Structs for readability */
+typedef struct TraceEvent Span;
+typedef struct TraceTrack Track;
+
+/* A span of time on a track */
+struct TraceEvent {
+    // Static name of what happened, e.g. "round".
+    const char *name;
+    // Track the span is drawn on, TRACE_HUB or TRACE_PLAYER of an id.
+    int track;
+    // Extra information shown with the span, e.g. the round number.
+    char detail[TRACE_DETAIL_LEN];
+    // Start and length in nanoseconds
+    long long start;
+    long long duration;
+};
+
+/* A named track, one for the hub and one for each player */
+struct TraceTrack {
+    int track;
+    char name[TRACE_NAME_LEN];
+};
+
+/*
+ * ===========================================================================
+ * Trace functions
+ * ===========================================================================
+ */
+/*
+ * Starts tracing into a preallocated buffer, written to path at exit.
+ *
+ * @param path      file to write the trace to.
+ * @return true if tracing started, false if the file can't be opened.
+ */
+bool trace_open(char *path);
+
+/*
+ * Checks if tracing is on.
+ *
+ * @return true if spans are being recorded.
+ */
+bool tracing(void);
+
+/*
+ * Names a track, shown as a thread in the trace viewer.
+ *
+ * @param track     the track, TRACE_HUB or TRACE_PLAYER of an id.
+ * @param format    printf style name of the track.
+ */
+void trace_name_track(int track, const char *format, ...);
+
+/*
+ * Starts a span on a track.
+ *
+ * @param track     the track, TRACE_HUB or TRACE_PLAYER of an id.
+ * @param name      static name of the span.
+ * @param format    printf style detail shown with the span.
+ * @return the span, to be passed to trace_end, or -1 if not recorded.
+ */
+int trace_begin(int track, const char *name, const char *format, ...);
+
+/*
+ * Ends a span started with trace_begin.
+ *
+ * @param span      the span returned by trace_begin.
+ */
+void trace_end(int span);
+
+/*
+ * Stops tracing without writing anything, so a forked process can start
+ * a trace of its own rather than add to its parent's.
+ */
+void trace_close(void);
+
+/*
+ * Writes all recorded spans as trace-event JSON. Only the process that
+ * started tracing writes, forked children never do.
+ */
+void trace_write(void);
+
+#endif